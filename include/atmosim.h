@@ -0,0 +1,113 @@
+/* C interface to atmosim, built as the libatmosim shared library
+ * nothing here allocates memory the caller has to free, and nothing throws:
+ * functions that can fail return a negative value and leave a message for atmosim_last_error() */
+#ifndef ATMOSIM_H
+#define ATMOSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* windows builds export everything instead */
+#if defined(_WIN32)
+#define ATMOSIM_API
+#else
+#define ATMOSIM_API __attribute__((visibility("default")))
+#endif
+
+#define ATMOSIM_MAX_GASES 16
+
+/* same layout as asim::recipe_record */
+typedef struct atmosim_recipe {
+    float fuel_temp, fuel_pressure, to_pressure, thir_temp;
+    uint8_t mix_count, primer_count;
+    uint8_t reserved[2];
+    /* gas indices as given by atmosim_gas_index(), mix gases first */
+    uint8_t gases[ATMOSIM_MAX_GASES];
+    /* fractions of their mix, same order as gases */
+    float fractions[ATMOSIM_MAX_GASES];
+} atmosim_recipe;
+
+enum atmosim_tank_state {
+    ATMOSIM_INTACT = 0,
+    ATMOSIM_RUPTURED = 1,
+    ATMOSIM_EXPLODED = 2
+};
+
+typedef struct atmosim_result {
+    float radius, pressure, temperature;
+    int32_t ticks;
+    /* an atmosim_tank_state */
+    int32_t state;
+    /* nonzero if the recipe was invalid, in which case the rest is zeroed */
+    int32_t error;
+} atmosim_result;
+
+typedef struct atmosim_optimise_params {
+    uint8_t mix_gases[ATMOSIM_MAX_GASES];
+    uint8_t primer_gases[ATMOSIM_MAX_GASES];
+    uint8_t mix_count, primer_count;
+    /* ranges to search, min and max may be equal */
+    float mix_temp_min, mix_temp_max, thir_temp_min, thir_temp_max, pressure_min, pressure_max;
+    /* minimum temperature to mix to */
+    float lower_target_temp;
+    /* search bound for the log of gas ratios */
+    float ratio_bound;
+    /* nonzero to also search the temperature to mix to, otherwise the lowest allowed is used */
+    int32_t mix_to_iter;
+    /* field to optimise, as the CLI's --param, NULL for radius */
+    const char* param;
+    int32_t maximise;
+    int32_t measure_before;
+    /* 0 for no limit */
+    uint64_t tick_cap;
+    float round_temp_to, round_pressure_to, round_ratio_to;
+    float runtime_seconds;
+    uint32_t rounds;
+    float bounds_scale;
+    /* 0 for no limit */
+    uint64_t max_evals;
+} atmosim_optimise_params;
+
+/* return nonzero to stop the optimisation early, keeping the best result so far */
+typedef int (*atmosim_progress_fn)(float progress, uint64_t evals, float best, void* user);
+
+typedef struct atmosim_context atmosim_context;
+
+/* the message of the last error on this thread, empty if none */
+ATMOSIM_API const char* atmosim_last_error(void);
+
+ATMOSIM_API size_t atmosim_gas_count(void);
+/* NULL if out of range */
+ATMOSIM_API const char* atmosim_gas_name(size_t index);
+/* -1 if there's no such gas */
+ATMOSIM_API int atmosim_gas_index(const char* name);
+
+/* replaces the current config with the given TOML document, in the format of ATMOSIM_CONFIG files
+ * not safe to call while any other atmosim call is running; returns 0 on success */
+ATMOSIM_API int atmosim_load_config(const char* toml, size_t length);
+
+/* n_threads counts the calling thread, so 1 runs everything on the caller; NULL on failure */
+ATMOSIM_API atmosim_context* atmosim_create(size_t n_threads);
+ATMOSIM_API void atmosim_destroy(atmosim_context* ctx);
+
+/* simulates count recipes into results, up to tick_cap ticks each or 0 for no limit
+ * returns how many recipes were invalid, leaving the first invalid one's message for atmosim_last_error() */
+ATMOSIM_API int64_t atmosim_simulate(atmosim_context* ctx, const atmosim_recipe* recipes, atmosim_result* results, size_t count, uint64_t tick_cap);
+
+/* fills params with the CLI's defaults, leaving the gases and temperature ranges empty */
+ATMOSIM_API void atmosim_optimise_defaults(atmosim_optimise_params* params);
+/* searches for the best recipe, calling progress (if not NULL) on the calling thread every poll
+ * returns 0 and fills best and best_result if anything valid was found, 1 if not, negative on error */
+ATMOSIM_API int atmosim_optimise(atmosim_context* ctx, const atmosim_optimise_params* params,
+                                 atmosim_progress_fn progress, void* user,
+                                 atmosim_recipe* best, atmosim_result* best_result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
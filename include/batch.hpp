@@ -0,0 +1,33 @@
+#pragma once
+
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "constants.hpp"
+#include "thread_pool.hpp"
+
+namespace asim {
+
+struct batch_options {
+    size_t tick_cap = std::numeric_limits<size_t>::max();
+    // also measure tolerances of every recipe, considerably slower
+    bool tolerances = false;
+    float tol = default_tol;
+    // what tolerances are measured down to
+    float round_pressure_to = 0.1f, round_temp_to = 0.01f, round_ratio_to = 0.00001f;
+    // how many lines to keep in flight at once, 0 for 64 per thread
+    size_t chunk_size = 0;
+};
+
+// simulates one serialised recipe, giving bomb_data::to_json() with tolerances added if enabled
+// throws if the recipe doesn't parse
+std::string simulate_recipe_json(std::string_view recipe, const batch_options& opts, thread_pool& pool);
+
+// simulates serialised recipes read from in, one per line, writing a JSON line of results per recipe in input order
+// every line has the 1-based input line number as "line", lines that failed to parse get an "error" instead of results
+// returns how many recipes were read
+size_t run_batch(std::istream& in, std::ostream& out, const batch_options& opts, thread_pool& pool);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace asim {
+
+// everything optimiser::find_best() needs to carry on where it stopped
+// results aren't stored, they're recomputed from their arguments on resume
+struct optimiser_checkpoint {
+    struct sampler_state {
+        size_t pop_size = 0;
+        size_t restarts = 0;
+        size_t init_count = 0;
+        size_t stall_count = 0;
+        bool seed_best = true;
+        bool stalled = false;
+        std::mt19937 rng;
+        std::vector<float> cur_lower_bounds, cur_upper_bounds;
+        std::vector<std::vector<float>> population;
+    };
+
+    // identifies the problem, checked on resume
+    std::string key;
+    std::vector<float> lower_bounds, upper_bounds;
+    uint64_t init_seed = 0;
+
+    size_t round = 0;
+    // false if the round hasn't started yet, so samplers start it fresh
+    bool in_round = false;
+    float round_elapsed = 0.f;
+    size_t eval_count = 0, sample_count = 0, valid_sample_count = 0;
+    bool any_valid = false;
+    std::vector<float> cur_lower_bounds, cur_upper_bounds;
+    // empty if there's no such result
+    std::vector<float> best_arg, round_start_arg;
+    std::vector<std::vector<float>> top_args;
+    std::vector<sampler_state> samplers;
+
+    // writes to a temporary file next to path, then replaces path with it
+    void save(const std::string& path) const;
+    // throws std::runtime_error if the file can't be read or isn't a checkpoint
+    static optimiser_checkpoint load(const std::string& path);
+};
+
+}
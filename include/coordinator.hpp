@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "optimise.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+struct coordinator_options {
+    size_t workers = 2;
+    // threads each worker's server runs its optimiser on
+    size_t worker_threads = 1;
+    // empty to fork this process and run a server in the child, otherwise the command to run instead,
+    // which has to speak the --server protocol over stdin/stdout, e.g. {"./atmosim", "--server", "-j=2"}
+    std::vector<std::string> worker_command;
+    // what every worker optimises; the first epoch splits its fuel temperature range between workers, later ones give every worker all of it
+    // its runtime and max_evals are for the whole run, and get split between the requests sent
+    optimise_options request;
+    // the runtime is split into this many epochs, after each every worker gets the best result so far to continue from
+    size_t epochs = 4;
+    // a worker not replying this long after its epoch should have ended is killed
+    float timeout_grace = 5.f;
+    // how often each worker may be restarted after dying
+    size_t max_restarts = 3;
+    size_t log_level = LOG_NONE;
+};
+
+struct coordinator_result {
+    // the best optimise reply of any worker, empty if none found anything valid
+    std::string best_json;
+    std::vector<float> best_arg;
+    float best_optstat = 0.f;
+    // arg of every valid reply, to pick more than the best from
+    std::vector<std::vector<float>> result_args;
+    size_t evals = 0;
+    size_t worker_deaths = 0;
+};
+
+// island-model optimisation over worker processes, each a server reached through pipes
+// workers optimise on their own between epochs, so the only shared state is the best result, merged here
+// dead or hung workers get restarted for the next epoch; only supported on POSIX systems
+coordinator_result run_coordinator(const coordinator_options& opts);
+
+}
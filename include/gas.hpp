@@ -14,26 +14,28 @@ namespace asim {
 
 // a gas type definition
 struct gas_type {
+    // before heat scaling, kept for load_config()
+    float base_specific_heat;
     float specific_heat;
     std::string name;
 
-    gas_type(float specheat, std::string_view name): specific_heat(specheat), name(name) {};
+    gas_type(float specheat, std::string_view name): base_specific_heat(specheat), specific_heat(specheat * heat_scale), name(name) {};
     gas_type() = delete;
     gas_type(const gas_type& rhs) = delete;
 };
 
 // all supported gases - if it's not here, it's not supported
 // UP TO DATE AS OF: 21.06.2025
-inline const gas_type gas_types[] {
-    {20.f  * heat_scale, "oxygen"},
-    {30.f  * heat_scale, "nitrogen"},
-    {200.f * heat_scale, "plasma"},
-    {10.f  * heat_scale, "tritium"},
-    {40.f  * heat_scale, "water_vapour"},
-    {30.f  * heat_scale, "carbon_dioxide"},
-    {600.f * heat_scale, "frezon"},
-    {40.f  * heat_scale, "nitrous_oxide"},
-    {10.f  * heat_scale, "nitrium"}
+inline gas_type gas_types[] {
+    {20.f, "oxygen"},
+    {30.f, "nitrogen"},
+    {200.f, "plasma"},
+    {10.f, "tritium"},
+    {40.f, "water_vapour"},
+    {30.f, "carbon_dioxide"},
+    {600.f, "frezon"},
+    {40.f, "nitrous_oxide"},
+    {10.f, "nitrium"}
 };
 
 inline const size_t gas_count = std::end(gas_types) - std::begin(gas_types);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "constants.hpp"
+#include "gas.hpp"
+#include "optimiser.hpp"
+#include "sim.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+// everything a search for the best bomb over do_sim takes, as given to atmosim's flags, --server optimise requests and atmosim_optimise()
+// names and units follow the flags, so ratios are percentages here too
+struct optimise_options {
+    std::vector<gas_ref> mix_gases, primer_gases;
+    float mixt1 = 0.f, mixt2 = 0.f, thirt1 = 0.f, thirt2 = 0.f;
+    float lower_pressure = pressure_cap, upper_pressure = pressure_cap;
+    float lower_target_temp = plasma_fire_temp + 0.1f;
+    // also search over the mix-to temperature, or solve it per candidate instead, see target_solve_args; solving wins if both are set
+    bool mix_to_iter = false, mix_to_solve = false;
+    float ratio_bound = 3.f;
+    // bounds for every ratio instead of +-ratio_bound, like --ratiobounds
+    std::vector<float> ratio_lower, ratio_upper;
+    size_t tick_cap = std::numeric_limits<size_t>::max();
+    float round_temp_to = 0.01f, round_pressure_to = 0.1f;
+    // 0.001% by default to mitigate FP inaccuracy
+    float round_ratio_to = 0.001f;
+    field_ref<bomb_data> opt_param = bomb_data::radius_field;
+    bool maximise = true, measure_before = false;
+    std::vector<field_restriction<bomb_data>> pre_restrictions, post_restrictions;
+    // see robust_args, all 0 to rate bombs as they are
+    float robust_temp = 0.f, robust_pressure = 0.f, robust_ratio = 0.f;
+    float robust_quantile = 0.f;
+    // see screen_args, empty to not screen
+    std::vector<size_t> screen_horizons;
+    float screen_keep = 1.f / 3.f;
+    // uniform, sobol or lhs
+    std::string init_mode = "uniform";
+    float runtime = 3.f;
+    size_t rounds = 5;
+    float bounds_scale = 0.5f;
+    size_t max_evals = 0;
+    size_t stall_gens = 0;
+    float stall_eps = 0.f;
+    bool restarts = false;
+    float restart_growth = 2.f;
+    size_t surrogate_size = 0, surrogate_k = 5;
+    float surrogate_explore = 0.1f;
+    size_t sensitivity_trajectories = 0;
+    float freeze_threshold = 0.05f;
+
+    // throws std::runtime_error if these can't be optimised with
+    void validate() const;
+    // do_sim's bounds: mix-to temp, fuel temp, primer temp, pressure, then a ratio for every gas after the first of each mix
+    std::pair<std::vector<float>, std::vector<float>> bounds() const;
+
+    // the fields of an optimise request, see server.hpp, without braces, "op", "id", "threads" or "seed"
+    std::string to_json_fields() const;
+    // reads what to_json_fields() writes, anything missing but the gases and temperatures is left at its default
+    static optimise_options from_json(const json_object& obj);
+};
+
+// an optimiser set up from optimise_options, along with the state its bomb_args point to
+// leaves threads, pools, seeds and output to the caller
+struct optimise_run {
+    using optimiser_t = optimiser<bomb_args, opt_val_wrap>;
+
+    // throws std::runtime_error if opts don't validate
+    explicit optimise_run(const optimise_options& opts, size_t log_level = LOG_NONE);
+
+    const optimise_options opts;
+    robust_args robust;
+    screen_args screen;
+    target_solve_args solve_target;
+    optimiser_t optim;
+};
+
+}
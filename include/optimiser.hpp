@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
@@ -9,10 +10,13 @@
 #include <functional>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <thread>
 #include <vector>
 
+#include "checkpoint.hpp"
+#include "thread_pool.hpp"
 #include "utility.hpp"
 
 namespace asim {
@@ -33,6 +37,58 @@ struct optimiser {
     float bounds_scale;
     size_t sample_rounds;
 
+    // Termination criteria
+    // total amount of function evaluations per find_best() call, 0 for no limit
+    size_t max_evals = 0;
+    // a sampler stalls if its population best hasn't improved by more than stall_epsilon for this many generations, 0 to disable
+    // if a whole round stalls without improving on the previous round, the run is stopped
+    size_t stall_generations = 0;
+    float stall_epsilon = 0.f;
+    // a sampler also stalls if its population's spread in every non-fixed dimension falls below this, empty to disable
+    std::vector<float> min_spread;
+
+    // How to draw initial populations, low-discrepancy modes cover the space more evenly
+    enum init_mode_t {init_uniform, init_sobol, init_lhs};
+    init_mode_t init_mode = init_uniform;
+    // shared by all samplers so their low-discrepancy draws are disjoint parts of one sequence
+    uint64_t init_seed = std::random_device{}();
+
+    // known good points to start from, find_best() centres its first round on the best of them
+    // and puts the rest into the samplers' first populations; seeds outside the bounds are moved to the nearest point inside them
+    std::vector<std::vector<float>> seeds;
+    // what find_best() rated each seed, so samplers needn't simulate them again
+    std::vector<R> seed_results;
+
+    // Surrogate pre-screening: samplers remember this many of their latest evaluations, 0 to disable,
+    // and skip simulating trials which their surrogate_k nearest neighbours there predict to lose selection
+    size_t surrogate_size = 0;
+    size_t surrogate_k = 5;
+    // fraction of trials predicted to lose that get simulated anyway, to keep the predictions honest
+    float surrogate_explore = 0.1f;
+    // of the last find_best(): trials skipped, and of the simulated ones predicted to lose [0] or win [1], how many and how many of those did
+    mutable std::atomic<size_t> surrogate_skipped{0};
+    mutable std::atomic<size_t> surrogate_checked[2]{}, surrogate_correct[2]{};
+
+    // Sensitivity pass: before its first round, find_best() estimates how much each dimension matters with this many
+    // Morris trajectories, 0 to skip, and freezes dimensions whose mean absolute elementary effect is below
+    // freeze_threshold times the largest at the best result so far, for the rest of the run
+    size_t sensitivity_trajectories = 0;
+    float freeze_threshold = 0.05f;
+    struct dim_sensitivity {
+        // mean absolute and standard deviation of elementary effects, per unit of the dimension's bounds
+        float mu_star = 0.f, sigma = 0.f;
+        // how many effects were measured, and how many steps went between a valid and an invalid result instead
+        size_t effects = 0, validity_flips = 0;
+        bool frozen = false;
+    };
+    // of the last sensitivity pass, empty if there was none
+    std::vector<dim_sensitivity> sensitivity;
+
+    // Restarts (IPOP-style): instead of stalling, a sampler restarts over the full bounds with a larger population
+    bool restart_on_stall = false;
+    float restart_pop_growth = 2.f;
+    size_t max_pop_size = 400;
+
     // DE Parameters
     // Population size: usually 10x dimension, but we clamp for performance/time trade-off
     size_t pop_size = 50;
@@ -48,13 +104,44 @@ struct optimiser {
     // State
     time_point_t last_poll_time;
     time_point_t last_speed_update_time;
+    // shared between samplers
+    mutable std::atomic<size_t> eval_count{0};
 
     // Inter-round state
     std::vector<float> best_arg;
     R best_result;
 
+    // grid_search() and find_best() results, best first
+    std::vector<std::pair<std::vector<float>, R>> top_results;
+    // how many results find_best() keeps in top_results, 0 to only keep best_result
+    size_t top_count = 0;
+    // results within this of a better one count as the same and are left out of top_results, see arg_distance()
+    float top_distance = 0.f;
+    // if set, find_best() calls this on its own thread as soon as a result enters top_results, with its index there
+    std::function<void(const std::vector<float>&, const R&, size_t)> on_top_result;
+
     // Dimensions we don't want to be stepping in
     std::vector<bool> fixed_dims;
+    // where fixed dimensions are held, which for ones the sensitivity pass froze isn't their lower bound
+    std::vector<float> fixed_at;
+
+    // if set, samplers take turns on this shared pool each poll instead of running on their own threads
+    thread_pool* pool = nullptr;
+    // if set, find_best() and grid_search() stop early once this becomes true
+    const std::atomic<bool>* cancel_flag = nullptr;
+    // if set, find_best() calls this on its own thread after every poll with the fraction of the runtime used so far
+    std::function<void(float)> on_poll;
+    // if set, find_best() calls this before evaluating anything, to reset state the objective keeps between calls
+    std::function<void()> on_start;
+
+    // Checkpointing
+    // if set, find_best() saves its state here every checkpoint_spacing, in the background, and once more when it stops
+    std::string checkpoint_path;
+    duration_t checkpoint_spacing = as_seconds(60.f);
+    // saved with checkpoints, resume() refuses ones with a different key, for problems of the same dimensions
+    std::string checkpoint_key;
+    // set by resume(), consumed by the next find_best()
+    std::optional<optimiser_checkpoint> resume_state;
 
     optimiser(std::function<R(const std::vector<float>&, T)> func,
               const std::vector<float>& lowerb,
@@ -102,11 +189,46 @@ struct optimiser {
         for(size_t i = 0; i < dims; ++i) {
             fixed_dims[i] = (lower_bounds[i] == upper_bounds[i]);
         }
+        fixed_at = lower_bounds;
 
         last_poll_time = main_clock.now();
         last_speed_update_time = main_clock.now();
     }
 
+    // makes the next find_best() carry on from a checkpoint instead of starting over
+    // throws std::runtime_error if the checkpoint is of a different problem
+    void resume(const std::string& path) {
+        optimiser_checkpoint ck = optimiser_checkpoint::load(path);
+        if (ck.key != checkpoint_key || ck.lower_bounds != lower_bounds || ck.upper_bounds != upper_bounds) {
+            throw std::runtime_error("checkpoint " + path + " is of a different problem");
+        }
+        size_t dims = lower_bounds.size();
+        auto bad_dims = [&](const std::vector<float>& arg) { return arg.size() != dims; };
+        bool valid = !bad_dims(ck.cur_lower_bounds) && !bad_dims(ck.cur_upper_bounds)
+                     && (ck.best_arg.empty() || !bad_dims(ck.best_arg)) && (ck.round_start_arg.empty() || !bad_dims(ck.round_start_arg))
+                     && std::none_of(ck.top_args.begin(), ck.top_args.end(), bad_dims);
+        for (const auto& samp : ck.samplers) {
+            valid &= !bad_dims(samp.cur_lower_bounds) && !bad_dims(samp.cur_upper_bounds)
+                     && std::none_of(samp.population.begin(), samp.population.end(), bad_dims);
+        }
+        if (!valid) {
+            throw std::runtime_error("checkpoint " + path + " has mismatched dimensions");
+        }
+        resume_state = std::move(ck);
+    }
+
+    bool evals_exhausted() const {
+        return max_evals != 0 && eval_count.load(std::memory_order_relaxed) >= max_evals;
+    }
+
+    bool cancelled() const {
+        return status_SIGINT || (cancel_flag && cancel_flag->load(std::memory_order_relaxed));
+    }
+
+    bool should_stop() const {
+        return cancelled() || evals_exhausted();
+    }
+
     struct sampler {
         const optimiser<T, R>& parent;
 
@@ -121,6 +243,31 @@ struct optimiser {
         // state
         std::vector<float> best_arg;
         R best_result;
+        // our copy of the parent's top_results, merged back every poll
+        std::vector<std::pair<std::vector<float>, R>> top_results;
+
+        // DE population, one row per member, kept between polls for the duration of a round
+        float_matrix population;
+        std::vector<R> fitness;
+        // reused for every trial, so evolving doesn't allocate
+        std::vector<float> trial;
+
+        // surrogate memory, a ring of our latest evaluations in bounds-normalised coordinates
+        float_matrix memory;
+        std::vector<float> memory_ratings;
+        std::vector<char> memory_valid;
+        size_t memory_next = 0;
+        // scratch space for predictions
+        std::vector<float> normalised_trial;
+        std::vector<std::pair<float, size_t>> neighbour_dists;
+
+        // stagnation detection
+        R stall_best;
+        size_t stall_count = 0;
+        bool stalled = false;
+        // whether to put the best result into a fresh population, false after a restart so we look elsewhere
+        bool seed_best = true;
+        size_t restarts = 0;
 
         time_point_t until;
 
@@ -142,8 +289,13 @@ struct optimiser {
         // RNG
         std::mt19937 rng;
 
+        // low-discrepancy initialisation state
+        size_t sampler_idx;
+        size_t init_count = 0;
+        std::unique_ptr<sobol_sequence> sobol = nullptr;
+
         sampler(const optimiser<T, R>& parent, int index = -1, bool do_threading = true)
-            : parent(parent), rng(std::random_device{}()) {
+            : parent(parent), rng(std::random_device{}()), sampler_idx(std::max(index, 0)) {
 
             if (index >= 0) {
                 worker_prefix = std::format("[{}]: ", index);
@@ -159,7 +311,7 @@ struct optimiser {
 
                         ready_mutex.lock();
                         while (main_clock.now() < until) {
-                            if(status_SIGINT) break;
+                            if (stalled || this->parent.should_stop()) break;
                             do_sampling();
                         }
                         ready_mutex.unlock();
@@ -179,18 +331,50 @@ struct optimiser {
             }
         }
 
-        void reset(const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) {
+        // sync with the parent, done every poll
+        void reset() {
             log_level = parent.log_level;
             maximise = parent.maximise;
 
-            pop_size = parent.pop_size;
             F = parent.mutation_factor;
             CR = parent.crossover_prob;
 
             best_arg = parent.best_arg;
             best_result = parent.best_result;
+            top_results = parent.top_results;
+        }
+
+        // drop the population so the next do_sampling() starts fresh in the given bounds
+        void start_round(const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) {
+            pop_size = parent.pop_size;
             cur_lower_bounds = lower_bounds;
             cur_upper_bounds = upper_bounds;
+            seed_best = true;
+            restarts = 0;
+            clear_population();
+        }
+
+        void clear_population() {
+            population.clear();
+            fitness.clear();
+            stall_best = R();
+            stall_count = 0;
+            stalled = false;
+        }
+
+        // start over in the original bounds with a bigger population, keeping our best result
+        void restart() {
+            // never below what DE can evolve, or we'd restart without sampling anything
+            pop_size = std::max((size_t)4, std::min(parent.max_pop_size, (size_t)(pop_size * parent.restart_pop_growth)));
+            cur_lower_bounds = parent.lower_bounds;
+            cur_upper_bounds = parent.upper_bounds;
+            for (size_t j = 0; j < cur_lower_bounds.size(); ++j) {
+                if (parent.fixed_dims[j]) cur_lower_bounds[j] = cur_upper_bounds[j] = parent.fixed_at[j];
+            }
+            seed_best = false;
+            ++restarts;
+            clear_population();
+            log([&]{ return std::format("{}Restart {} with population {}", worker_prefix, restarts, pop_size); }, log_level, LOG_INFO);
         }
 
         void start_sampling(time_point_t until) {
@@ -200,7 +384,7 @@ struct optimiser {
                 cv.notify_one();
             } else {
                 while (main_clock.now() < until) {
-                    if(status_SIGINT) break;
+                    if (stalled || parent.should_stop()) break;
                     do_sampling();
                 }
                 running = false;
@@ -216,77 +400,276 @@ struct optimiser {
             // Differential Evolution Implementation
             size_t dims = cur_lower_bounds.size();
 
-            // Population initialization
-            std::vector<std::vector<float>> population(pop_size);
-            std::vector<R> fitness(pop_size);
-
-            std::uniform_real_distribution<float> dist01(0.f, 1.f);
+            // 1. Initialize Population
+            if (population.empty()) {
+                population.cols = dims;
+                population.resize(pop_size);
+                fitness.resize(pop_size);
+
+                // if we already have a best result, keep it as the first element of the population
+                size_t start = 0;
+                if (seed_best && best_result.valid()) {
+                    population.set_row(0, best_arg);
+                    fitness[0] = best_result;
+                    start = 1;
+                }
 
-            // if we already have a best result, keep it as the first element of the population
-            size_t start = 0;
-            if (best_result.valid()) {
-                population[0] = best_arg;
-                fitness[0] = best_result;
-                start = 1;
+                // our share of the parent's seeds goes into our first population, after its best
+                if (init_count == 0) {
+                    for (size_t i = sampler_idx; i < parent.seeds.size() && start < pop_size / 2; i += parent.n_threads) {
+                        std::span<float> member = population[start];
+                        for (size_t j = 0; j < dims; ++j) {
+                            member[j] = std::clamp(parent.seeds[i][j], cur_lower_bounds[j], cur_upper_bounds[j]);
+                        }
+                        if (std::ranges::equal(member, best_arg) && seed_best) continue;
+                        // seeds the current bounds moved are different points, so rate them anew
+                        if (i < parent.seed_results.size() && std::ranges::equal(member, parent.seeds[i])) {
+                            fitness[start] = parent.seed_results[i];
+                        } else {
+                            if (parent.evals_exhausted()) break;
+                            trial.assign(member.begin(), member.end());
+                            fitness[start] = sample(trial);
+                        }
+                        ++start;
+                    }
+                }
+                init_points(start, pop_size);
+                for (size_t i = start; i < pop_size; ++i) {
+                    if (parent.evals_exhausted()) {
+                        population.resize(i);
+                        fitness.resize(i);
+                        break;
+                    }
+                    trial.assign(population[i].begin(), population[i].end());
+                    fitness[i] = sample(trial);
+                }
             }
 
-            // 1. Initialize Population
-            for (size_t i = start; i < pop_size; ++i) {
-                population[i] = random_vec(cur_lower_bounds, cur_upper_bounds);
-                fitness[i] = sample(population[i]);
+            // too small to evolve, can only happen if we ran out of evaluations
+            size_t n_pop = population.size();
+            if (n_pop < 4) {
+                return;
             }
 
-            std::vector<float> trial(dims);
+            trial.resize(dims);
 
             // 2. Evolution Loop
             // We run generation by generation until the 'until' time is hit
             // The outer loop in sampler handles the timing check
 
-            while (main_clock.now() < until && !status_SIGINT) {
-                for (size_t i = 0; i < pop_size; ++i) {
+            while (main_clock.now() < until && !stalled && !parent.cancelled()) {
+                for (size_t i = 0; i < n_pop; ++i) {
+                    if (parent.evals_exhausted()) return;
+
                     // Pick 3 distinct random indices (a, b, c) != i
                     size_t a, b, c;
-                    do { a = std::uniform_int_distribution<size_t>(0, pop_size - 1)(rng); } while(a == i);
-                    do { b = std::uniform_int_distribution<size_t>(0, pop_size - 1)(rng); } while(b == i || b == a);
-                    do { c = std::uniform_int_distribution<size_t>(0, pop_size - 1)(rng); } while(c == i || c == a || c == b);
+                    do { a = std::uniform_int_distribution<size_t>(0, n_pop - 1)(rng); } while(a == i);
+                    do { b = std::uniform_int_distribution<size_t>(0, n_pop - 1)(rng); } while(b == i || b == a);
+                    do { c = std::uniform_int_distribution<size_t>(0, n_pop - 1)(rng); } while(c == i || c == a || c == b);
 
                     // Mutation & Crossover
                     // DE/rand/1/bin strategy
                     // Mutant = a + F * (b - c)
                     size_t R_idx = std::uniform_int_distribution<size_t>(0, dims - 1)(rng);
 
+                    // the mutant for every dimension at once, contiguous rows let this vectorise
+                    std::span<const float> pa = population[a], pb = population[b], pc = population[c], pi = population[i];
+                    for (size_t j = 0; j < dims; ++j) {
+                        float val = pa[j] + F * (pb[j] - pc[j]);
+                        // Bound handling: Clamp
+                        trial[j] = std::max(cur_lower_bounds[j], std::min(cur_upper_bounds[j], val));
+                    }
+                    // then crossover with the current member
                     for (size_t j = 0; j < dims; ++j) {
                         if (parent.fixed_dims[j]) {
                             trial[j] = cur_lower_bounds[j];
-                            continue;
+                        } else if (!(frand() < CR || j == R_idx)) {
+                            trial[j] = pi[j];
                         }
+                    }
 
-                        if (frand() < CR || j == R_idx) {
-                            float val = population[a][j] + F * (population[b][j] - population[c][j]);
-                            // Bound handling: Clamp
-                            val = std::max(cur_lower_bounds[j], std::min(cur_upper_bounds[j], val));
-                            trial[j] = val;
-                        } else {
-                            trial[j] = population[i][j];
-                        }
+                    // skip trials the surrogate expects to lose, apart from a few to check it's right
+                    int prediction = predict_win(trial, fitness[i]);
+                    if (prediction == 0 && std::uniform_real_distribution<float>()(rng) >= parent.surrogate_explore) {
+                        parent.surrogate_skipped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
                     }
 
                     // Selection
                     R trial_res = sample(trial);
 
-                    if (parent.better_eq_than(trial_res, fitness[i], maximise)) {
-                        population[i] = trial;
+                    bool wins = parent.better_eq_than(trial_res, fitness[i], maximise);
+                    if (prediction != -1) {
+                        parent.surrogate_checked[prediction].fetch_add(1, std::memory_order_relaxed);
+                        parent.surrogate_correct[prediction].fetch_add(wins == (prediction == 1), std::memory_order_relaxed);
+                    }
+                    if (wins) {
+                        population.set_row(i, trial);
                         fitness[i] = trial_res;
                     }
                 }
+
+                check_stall();
+                if (stalled && parent.restart_on_stall && pop_size < parent.max_pop_size) {
+                    restart();
+                    return;
+                }
             }
         }
 
+        // fills population rows [from, to) with points in current bounds according to the parent's init mode
+        void init_points(size_t from, size_t to) {
+            size_t count = to - from;
+            size_t n_samplers = parent.n_threads;
+            // the k-th init of every sampler uses the k-th part of the sequence, split between samplers
+            size_t init_idx = init_count++;
+            init_mode_t mode = parent.init_mode;
+            if (mode == init_sobol && cur_lower_bounds.size() > sobol_sequence::max_dims) {
+                mode = init_lhs;
+            }
+            switch (mode) {
+                case (init_sobol): {
+                    if (!sobol) {
+                        sobol = std::make_unique<sobol_sequence>(cur_lower_bounds.size(), parent.init_seed);
+                    }
+                    // power of two blocks of a Sobol sequence are well-distributed on their own
+                    uint64_t block = std::bit_ceil((uint64_t)std::max({count, parent.pop_size, parent.max_pop_size}));
+                    uint64_t block_start = (init_idx * n_samplers + sampler_idx) * block;
+                    for (size_t i = 0; i < count; ++i) {
+                        population.set_row(from + i, sobol->at(block_start + i, cur_lower_bounds, cur_upper_bounds));
+                    }
+                    break;
+                }
+                case (init_lhs): {
+                    std::vector<std::vector<float>> points = latin_hypercube(count, n_samplers, sampler_idx, parent.init_seed + init_idx * 0x9E3779B97F4A7C15ull,
+                                                                             cur_lower_bounds, cur_upper_bounds);
+                    for (size_t i = 0; i < count; ++i) population.set_row(from + i, points[i]);
+                    break;
+                }
+                default: {
+                    for (size_t i = from; i < to; ++i) {
+                        population.set_row(i, random_vec(cur_lower_bounds, cur_upper_bounds));
+                    }
+                    break;
+                }
+            }
+        }
+
+        // called at the end of every generation
+        void check_stall() {
+            if (parent.stall_generations != 0) {
+                size_t best_i = 0;
+                for (size_t i = 1; i < population.size(); ++i) {
+                    if (parent.better_than(fitness[i], fitness[best_i], maximise)) best_i = i;
+                }
+                const R& gen_best = fitness[best_i];
+                if (parent.improves_by(gen_best, stall_best, parent.stall_epsilon, maximise)) {
+                    stall_best = gen_best;
+                    stall_count = 0;
+                } else if (++stall_count >= parent.stall_generations) {
+                    log([&]{ return std::format("{}No improvement for {} generations, stalled", worker_prefix, stall_count); }, log_level, LOG_DEBUG);
+                    stalled = true;
+                }
+            }
+
+            if (!parent.min_spread.empty()) {
+                // spread below the rounding lattice means we're sampling the same points over and over
+                bool collapsed = true;
+                size_t dims = cur_lower_bounds.size();
+                for (size_t j = 0; j < dims && collapsed; ++j) {
+                    if (parent.fixed_dims[j]) continue;
+                    float min_v = population[0][j], max_v = min_v;
+                    for (size_t i = 1; i < population.size(); ++i) {
+                        min_v = std::min(min_v, population[i][j]);
+                        max_v = std::max(max_v, population[i][j]);
+                    }
+                    collapsed = max_v - min_v < parent.min_spread[j];
+                }
+                if (collapsed) {
+                    log([&]{ return std::format("{}Population collapsed, stalled", worker_prefix); }, log_level, LOG_DEBUG);
+                    stalled = true;
+                }
+            }
+        }
+
+        void normalise(std::span<const float> at, std::span<float> out) const {
+            for (size_t j = 0; j < at.size(); ++j) {
+                out[j] = parent.fixed_dims[j] ? 0.f : (at[j] - parent.lower_bounds[j]) / (parent.upper_bounds[j] - parent.lower_bounds[j]);
+            }
+        }
+
+        // k-NN guess of whether a trial beats target: 1 if so, 0 if not, -1 if there's nothing to go by
+        // neighbours vote inverse-distance weighted, first on whether it's valid at all, then with their ratings
+        int predict_win(const std::vector<float>& trial, const R& target) {
+            size_t k = parent.surrogate_k;
+            if (parent.surrogate_size == 0 || k == 0 || memory.size() < k || !target.valid() || parent.pruned(target)) return -1;
+
+            normalised_trial.resize(trial.size());
+            normalise(trial, normalised_trial);
+            neighbour_dists.resize(memory.size());
+            for (size_t m = 0; m < memory.size(); ++m) {
+                std::span<const float> point = memory[m];
+                float dist = 0.f;
+                for (size_t j = 0; j < point.size(); ++j) {
+                    float d = normalised_trial[j] - point[j];
+                    dist += d * d;
+                }
+                neighbour_dists[m] = {dist, m};
+            }
+            std::partial_sort(neighbour_dists.begin(), neighbour_dists.begin() + k, neighbour_dists.end());
+
+            auto wins = [&](float rating) { return (maximise ? rating >= target.rating() : rating <= target.rating()) ? 1 : 0; };
+            float valid_weight = 0.f, total_weight = 0.f, rating = 0.f;
+            for (size_t n = 0; n < k; ++n) {
+                auto [dist, m] = neighbour_dists[n];
+                // we've simulated this exact point before, no need to guess
+                if (dist == 0.f) {
+                    return memory_valid[m] ? wins(memory_ratings[m]) : 0;
+                }
+                float weight = 1.f / std::sqrt(dist);
+                total_weight += weight;
+                if (memory_valid[m]) {
+                    valid_weight += weight;
+                    rating += weight * memory_ratings[m];
+                }
+            }
+            if (valid_weight * 2.f < total_weight) return 0;
+            return wins(rating / valid_weight);
+        }
+
+        void remember(const std::vector<float>& at, const R& res) {
+            size_t row;
+            if (memory.size() < parent.surrogate_size) {
+                if (memory.empty()) {
+                    memory.cols = at.size();
+                    memory.data.reserve(parent.surrogate_size * at.size());
+                }
+                row = memory.size();
+                memory.resize(row + 1);
+                memory_ratings.push_back(0.f);
+                memory_valid.push_back(false);
+            } else {
+                row = memory_next;
+                memory_next = (memory_next + 1) % memory.size();
+            }
+            normalise(at, memory[row]);
+            memory_ratings[row] = res.valid() ? res.rating() : 0.f;
+            memory_valid[row] = res.valid();
+        }
+
         R sample(const std::vector<float>& at) {
             R res = parent.funct(at, parent.args);
+            // pruned results would teach the surrogate nothing true
+            if (parent.surrogate_size != 0 && !parent.pruned(res)) {
+                remember(at, res);
+            }
 
+            parent.eval_count.fetch_add(1, std::memory_order_relaxed);
             ++sample_count;
             valid_sample_count += res.valid();
+            if (parent.top_count != 0) {
+                parent.insert_top(top_results, at, res, parent.top_count);
+            }
 
             // Check against local best
             if (parent.better_than(res, best_result, maximise)) {
@@ -300,10 +683,117 @@ struct optimiser {
         }
     };
 
+    // Morris elementary effects screening, all trajectories simulated as one batch, see sensitivity_trajectories
+    void find_sensitivity() {
+        // with 4 levels, steps of 2/3 of the bounds make every level equally likely to be visited
+        const float levels = 4.f;
+        const float delta = levels / (2.f * (levels - 1.f));
+        size_t dims = lower_bounds.size();
+        std::vector<size_t> active;
+        for (size_t d = 0; d < dims; ++d) {
+            if (!fixed_dims[d]) active.push_back(d);
+        }
+        if (active.empty()) return;
+
+        std::mt19937 rng(init_seed);
+        std::uniform_int_distribution<int> level_dist(0, (int)levels - 1);
+        auto to_arg = [&](const std::vector<float>& unit) {
+            std::vector<float> arg(dims);
+            for (size_t d = 0; d < dims; ++d) arg[d] = lower_bounds[d] + unit[d] * (upper_bounds[d] - lower_bounds[d]);
+            return arg;
+        };
+        // each trajectory is a start point followed by one step in every active dimension, in random order
+        size_t steps = active.size() + 1;
+        std::vector<std::vector<float>> points;
+        std::vector<size_t> step_dims;
+        std::vector<float> step_signs;
+        for (size_t t = 0; t < sensitivity_trajectories; ++t) {
+            std::vector<float> unit(dims, 0.f);
+            for (size_t d : active) unit[d] = level_dist(rng) / (levels - 1.f);
+            points.push_back(to_arg(unit));
+            std::vector<size_t> order = active;
+            std::shuffle(order.begin(), order.end(), rng);
+            for (size_t d : order) {
+                float sign = unit[d] + delta <= 1.f ? 1.f : -1.f;
+                unit[d] += sign * delta;
+                points.push_back(to_arg(unit));
+                step_dims.push_back(d);
+                step_signs.push_back(sign);
+            }
+        }
+
+        std::vector<R> results(points.size());
+        auto eval_point = [&](size_t i) { results[i] = funct(points[i], args); };
+        if (pool) {
+            pool->parallel_for(points.size(), eval_point);
+        } else {
+            thread_pool(n_threads).parallel_for(points.size(), eval_point);
+        }
+        eval_count += points.size();
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (top_count != 0) insert_top(top_results, points[i], results[i], top_count);
+            if (better_than(results[i], best_result, maximise)) {
+                best_result = results[i];
+                best_arg = points[i];
+            }
+        }
+
+        sensitivity.assign(dims, {});
+        std::vector<float> sum(dims, 0.f), sum_sq(dims, 0.f);
+        for (size_t t = 0; t < sensitivity_trajectories; ++t) {
+            for (size_t k = 1; k < steps; ++k) {
+                const R& from = results[t * steps + k - 1];
+                const R& to = results[t * steps + k];
+                size_t step = t * (steps - 1) + k - 1;
+                size_t d = step_dims[step];
+                // a pruned result says nothing about how much the step mattered, or even whether it was valid
+                if (pruned(from) || pruned(to)) continue;
+                if (from.valid() != to.valid()) {
+                    ++sensitivity[d].validity_flips;
+                    continue;
+                }
+                if (!from.valid()) continue;
+                float effect = step_signs[step] * (to.rating() - from.rating()) / delta;
+                ++sensitivity[d].effects;
+                sensitivity[d].mu_star += std::abs(effect);
+                sum[d] += effect;
+                sum_sq[d] += effect * effect;
+            }
+        }
+        float max_mu = 0.f;
+        for (size_t d : active) {
+            dim_sensitivity& sens = sensitivity[d];
+            if (sens.effects == 0) continue;
+            float mean = sum[d] / sens.effects;
+            sens.mu_star /= sens.effects;
+            sens.sigma = std::sqrt(std::max(0.f, sum_sq[d] / sens.effects - mean * mean));
+            max_mu = std::max(max_mu, sens.mu_star);
+        }
+
+        // a dimension that can make the difference between valid and not matters however flat it is otherwise
+        if (best_result.valid()) {
+            for (size_t d : active) {
+                dim_sensitivity& sens = sensitivity[d];
+                if (sens.effects == 0 || sens.validity_flips != 0 || sens.mu_star >= freeze_threshold * max_mu) continue;
+                sens.frozen = true;
+                fixed_dims[d] = true;
+                fixed_at[d] = best_arg[d];
+            }
+        }
+        for (size_t d : active) {
+            log([&]{ return std::format("Dimension {}: mu* {}, sigma {}, {} effects, {} validity flips{}", d, sensitivity[d].mu_star, sensitivity[d].sigma,
+                                        sensitivity[d].effects, sensitivity[d].validity_flips, sensitivity[d].frozen ? ", frozen at " + std::format("{}", fixed_at[d]) : ""); },
+                log_level, LOG_INFO);
+        }
+        log([&]{ return std::format("Sensitivity pass took {} samples, froze {} of {} dimensions", points.size(),
+                                    std::count_if(sensitivity.begin(), sensitivity.end(), [](const dim_sensitivity& s) { return s.frozen; }), active.size()); },
+            log_level, LOG_BASIC);
+    }
+
     void find_best() {
         std::vector<std::unique_ptr<sampler>> samplers;
         for (size_t i = 0; i < n_threads; ++i) {
-            samplers.emplace_back(std::make_unique<sampler>(*this, i, n_threads != 1));
+            samplers.emplace_back(std::make_unique<sampler>(*this, i, n_threads != 1 && !pool));
         }
 
         bool any_valid = false;
@@ -314,30 +804,233 @@ struct optimiser {
         std::vector<float> cur_lower_bounds(lower_bounds);
         std::vector<float> cur_upper_bounds(upper_bounds);
 
-        for (size_t samp_idx = 0; samp_idx < sample_rounds; ++samp_idx) {
-            if (status_SIGINT) break;
+        if (on_start) {
+            on_start();
+        }
+        eval_count = 0;
+        top_results.clear();
+        // dimensions frozen by an earlier run's sensitivity pass are free again
+        reset();
+        sensitivity.clear();
+        surrogate_skipped = 0;
+        for (size_t i = 0; i < 2; ++i) surrogate_checked[i] = surrogate_correct[i] = 0;
+
+        size_t first_round = 0;
+        bool resumed_in_round = false;
+        float resumed_elapsed = 0.f;
+        // arg of the best result at the start of the current round, empty if there was none
+        std::vector<float> round_start_arg;
+        R round_start_best;
+        if (resume_state) {
+            const optimiser_checkpoint& ck = *resume_state;
+            // recomputed results don't count towards eval_count
+            auto eval = [&](const std::vector<float>& arg) { return arg.empty() ? R() : funct(arg, args); };
+            init_seed = ck.init_seed;
+            eval_count = ck.eval_count;
+            sample_count = ck.sample_count;
+            valid_sample_count = ck.valid_sample_count;
+            any_valid = ck.any_valid;
+            cur_lower_bounds = ck.cur_lower_bounds;
+            cur_upper_bounds = ck.cur_upper_bounds;
+            // dimensions the sensitivity pass froze show as empty bounds
+            for (size_t d = 0; d < cur_lower_bounds.size(); ++d) {
+                if (cur_lower_bounds[d] != cur_upper_bounds[d] || fixed_dims[d]) continue;
+                fixed_dims[d] = true;
+                fixed_at[d] = cur_lower_bounds[d];
+            }
+            if (!ck.best_arg.empty()) {
+                best_arg = ck.best_arg;
+                best_result = eval(best_arg);
+            }
+            round_start_arg = ck.round_start_arg;
+            round_start_best = eval(round_start_arg);
+            for (const std::vector<float>& arg : ck.top_args) {
+                if (top_count != 0) insert_top(top_results, arg, eval(arg), top_count);
+            }
+            first_round = ck.round;
+            resumed_in_round = ck.in_round;
+            resumed_elapsed = ck.round_elapsed;
+
+            // samplers past what was saved start the round fresh
+            std::vector<std::pair<sampler*, size_t>> members;
+            for (size_t i = 0; i < samplers.size(); ++i) {
+                sampler& samp = *samplers[i];
+                samp.start_round(cur_lower_bounds, cur_upper_bounds);
+                if (i >= ck.samplers.size()) continue;
+                const optimiser_checkpoint::sampler_state& state = ck.samplers[i];
+                samp.pop_size = state.pop_size;
+                samp.restarts = state.restarts;
+                samp.init_count = state.init_count;
+                samp.seed_best = state.seed_best;
+                samp.rng = state.rng;
+                samp.cur_lower_bounds = state.cur_lower_bounds;
+                samp.cur_upper_bounds = state.cur_upper_bounds;
+                samp.population = float_matrix(state.population);
+                samp.fitness.resize(samp.population.size());
+                for (size_t j = 0; j < samp.population.size(); ++j) members.emplace_back(&samp, j);
+            }
+            auto eval_member = [&](size_t k) {
+                auto [samp, j] = members[k];
+                samp->fitness[j] = funct(samp->population.row_vec(j), args);
+            };
+            if (pool) {
+                pool->parallel_for(members.size(), eval_member);
+            } else {
+                thread_pool(n_threads).parallel_for(members.size(), eval_member);
+            }
+            // stall_best is only approximated by the population's best, which it can't be better than
+            for (size_t i = 0; i < std::min(samplers.size(), ck.samplers.size()); ++i) {
+                sampler& samp = *samplers[i];
+                for (const R& res : samp.fitness) {
+                    if (better_than(res, samp.stall_best, maximise)) samp.stall_best = res;
+                }
+                samp.stall_count = ck.samplers[i].stall_count;
+                samp.stalled = ck.samplers[i].stalled;
+            }
+            resume_state.reset();
+            log([&]{ return std::format("Resumed in round {} after {} samples", first_round + 1, eval_count.load()); }, log_level, LOG_BASIC);
+        }
+
+        // contracts the current bounds to scale times the full ones, centred on the best result
+        auto zoom = [&](float scale) {
+            for (size_t d = 0; d < cur_lower_bounds.size(); ++d) {
+                if (fixed_dims[d]) continue;
+
+                float span = upper_bounds[d] - lower_bounds[d];
+                float current_span = span * scale;
+
+                // Center around best arg, but clamp to original hard bounds
+                cur_lower_bounds[d] = std::max(lower_bounds[d], best_arg[d] - current_span / 2.f);
+                cur_upper_bounds[d] = std::min(upper_bounds[d], best_arg[d] + current_span / 2.f);
+            }
+        };
+
+        if (!seeds.empty() && first_round == 0 && !resumed_in_round) {
+            seed_results.clear();
+            for (std::vector<float>& seed : seeds) {
+                if (seed.size() != lower_bounds.size()) throw std::runtime_error("optimiser seed has mismatched dimensions");
+                for (size_t d = 0; d < seed.size(); ++d) seed[d] = std::clamp(seed[d], lower_bounds[d], upper_bounds[d]);
+                R res = funct(seed, args);
+                seed_results.push_back(res);
+                ++eval_count;
+                if (top_count != 0) insert_top(top_results, seed, res, top_count);
+                if (better_than(res, best_result, maximise)) {
+                    best_result = res;
+                    best_arg = seed;
+                }
+            }
+            // a good seed makes searching the whole space first unnecessary
+            if (best_result.valid()) {
+                any_valid = true;
+                zoom(bounds_scale);
+                log([&]{ return std::format("Starting around best seed: {}", best_result.rating_str()); }, log_level, LOG_BASIC);
+            }
+        }
 
-            time_point_t s_time = main_clock.now();
-            // Divide total runtime by rounds
+        if (sensitivity_trajectories != 0 && first_round == 0 && !resumed_in_round) {
+            find_sensitivity();
+            any_valid |= best_result.valid();
+            for (size_t d = 0; d < sensitivity.size(); ++d) {
+                if (sensitivity[d].frozen) cur_lower_bounds[d] = cur_upper_bounds[d] = fixed_at[d];
+            }
+        }
+
+        // what the next checkpoint describes
+        size_t ck_round = first_round;
+        bool ck_in_round = resumed_in_round;
+        time_point_t s_time = main_clock.now();
+        time_point_t last_checkpoint_time = main_clock.now();
+        // the latest background write, if still going
+        std::jthread checkpoint_writer;
+
+        auto snapshot = [&] {
+            optimiser_checkpoint ck;
+            ck.key = checkpoint_key;
+            ck.lower_bounds = lower_bounds;
+            ck.upper_bounds = upper_bounds;
+            ck.init_seed = init_seed;
+            ck.round = ck_round;
+            ck.in_round = ck_in_round;
+            ck.round_elapsed = ck_in_round ? to_seconds(main_clock.now() - s_time) : 0.f;
+            ck.eval_count = eval_count;
+            ck.sample_count = sample_count;
+            ck.valid_sample_count = valid_sample_count;
+            ck.any_valid = any_valid;
+            ck.cur_lower_bounds = cur_lower_bounds;
+            ck.cur_upper_bounds = cur_upper_bounds;
+            if (best_result.valid()) ck.best_arg = best_arg;
+            ck.round_start_arg = round_start_arg;
+            for (const auto& [at, res] : top_results) ck.top_args.push_back(at);
+            for (const std::unique_ptr<sampler>& samp : samplers) {
+                ck.samplers.push_back({samp->pop_size, samp->restarts, samp->init_count, samp->stall_count, samp->seed_best, samp->stalled,
+                                       samp->rng, samp->cur_lower_bounds, samp->cur_upper_bounds, samp->population.to_rows()});
+            }
+            return ck;
+        };
+        // samplers are idle between polls, so snapshotting them is cheap and writing the file can happen off this thread
+        auto save_checkpoint = [&](bool background) {
+            if (checkpoint_writer.joinable()) checkpoint_writer.join();
+            auto write = [this](const optimiser_checkpoint& ck) {
+                try {
+                    ck.save(checkpoint_path);
+                } catch (const std::exception& e) {
+                    log([&]{ return std::format("Could not save checkpoint: {}", e.what()); }, log_level, LOG_BASIC);
+                }
+            };
+            if (background) {
+                checkpoint_writer = std::jthread(write, snapshot());
+            } else {
+                write(snapshot());
+            }
+            last_checkpoint_time = main_clock.now();
+        };
+
+        for (size_t samp_idx = first_round; samp_idx < sample_rounds; ++samp_idx) {
+            bool resuming = resumed_in_round && samp_idx == first_round;
+            ck_round = samp_idx;
+            ck_in_round = resuming;
+            if (cancelled()) break;
+            if (evals_exhausted()) {
+                log([&]{ return std::format("Evaluation budget of {} exhausted", max_evals); }, log_level, LOG_BASIC);
+                break;
+            }
+
+            // Divide total runtime by rounds, a resumed round only gets what it had left
             duration_t round_duration = max_duration / sample_rounds;
+            s_time = main_clock.now() - (resuming ? as_seconds(resumed_elapsed) : duration_t(0));
             time_point_t end_time = s_time + round_duration;
 
+            if (!resuming) {
+                for (std::unique_ptr<sampler>& samp : samplers) {
+                    samp->start_round(cur_lower_bounds, cur_upper_bounds);
+                }
+                round_start_arg = best_result.valid() ? best_arg : std::vector<float>();
+                round_start_best = best_result;
+            }
+            ck_in_round = true;
+            bool round_stalled = false;
+
             while (main_clock.now() < end_time) {
-                if (status_SIGINT) break;
+                if (should_stop()) break;
 
                 time_point_t from = main_clock.now();
                 time_point_t time_to = std::min(end_time, from + poll_spacing);
 
                 for (std::unique_ptr<sampler>& samp : samplers) {
-                    // Update bounds for the samplers (in case we tightened them previous round)
-                    samp->reset(cur_lower_bounds, cur_upper_bounds);
-                    samp->start_sampling(time_to);
+                    samp->reset();
+                }
+                if (pool) {
+                    pool->parallel_for(samplers.size(), [&](size_t i) { samplers[i]->start_sampling(time_to); });
+                } else {
+                    for (std::unique_ptr<sampler>& samp : samplers) {
+                        samp->start_sampling(time_to);
+                    }
+                    // just sleep until the samplers are done
+                    std::this_thread::sleep_until(time_to);
                 }
-
-                // just sleep until the samplers are done
-                std::this_thread::sleep_until(time_to);
 
                 // aggregate sampler data
+                round_stalled = true;
                 for (const std::unique_ptr<sampler>& samp : samplers) {
                     samp->wait_ready();
                     sample_count += samp->sample_count;
@@ -345,11 +1038,16 @@ struct optimiser {
                     samp->sample_count = 0;
                     samp->valid_sample_count = 0;
                     any_valid |= samp->best_result.valid();
+                    round_stalled &= samp->stalled;
 
                     if (better_than(samp->best_result, best_result, maximise)) {
                         best_result = samp->best_result;
                         best_arg = samp->best_arg;
                     }
+                    for (const auto& [at, res] : samp->top_results) {
+                        size_t idx = insert_top(top_results, at, res, top_count);
+                        if (idx != top_count && on_top_result) on_top_result(at, res, idx);
+                    }
                 }
 
                 if (log_level >= LOG_INFO) {
@@ -371,8 +1069,24 @@ struct optimiser {
                     }, log_level, LOG_INFO, false);
                     std::flush(std::cout);
                 }
+
+                if (on_poll) {
+                    on_poll(std::min(1.f, (samp_idx + to_seconds(main_clock.now() - s_time) / to_seconds(round_duration)) / sample_rounds));
+                }
+
+                if (!checkpoint_path.empty() && main_clock.now() - last_checkpoint_time >= checkpoint_spacing) {
+                    save_checkpoint(true);
+                }
+
+                if (round_stalled) {
+                    log([&]{ return "All samplers stalled, ending round early"; }, log_level, LOG_INFO);
+                    break;
+                }
             }
 
+            // a cancelled round is saved as it is, so resuming carries on with it
+            if (cancelled()) break;
+
             if (!any_valid && samp_idx < sample_rounds - 1) {
                 log([&]{ return "Failed to find any viable result this round, retrying..."; }, log_level, LOG_BASIC);
                 continue;
@@ -385,37 +1099,213 @@ struct optimiser {
                 if (samp_idx + 1 != sample_rounds) {
                     // Zooming Strategy:
                     // Contract bounds around the best known argument to refine precision
-                    float c_scale = std::pow(bounds_scale, samp_idx + 1);
+                    zoom(std::pow(bounds_scale, samp_idx + 1));
+
+                    log([&]{ return std::format("New bounds: [{}] to [{}]", vec_to_str(cur_lower_bounds), vec_to_str(cur_upper_bounds)); }, log_level, LOG_INFO);
+                }
+            }
 
-                    // Ensure we don't collapse to zero width on dimensions that need variation
-                    for(size_t d=0; d<cur_lower_bounds.size(); ++d) {
-                        if(fixed_dims[d]) continue;
+            ck_in_round = false;
+            ck_round = samp_idx + 1;
+            if (round_stalled && stall_generations != 0 && !improves_by(best_result, round_start_best, stall_epsilon, maximise)) {
+                log([&]{ return std::format("Round {} stalled without improving, stopping", samp_idx + 1); }, log_level, LOG_BASIC);
+                ck_round = sample_rounds;
+                break;
+            }
+        }
 
-                        float span = upper_bounds[d] - lower_bounds[d];
-                        float current_span = span * c_scale;
+        if (!checkpoint_path.empty()) {
+            save_checkpoint(false);
+        }
+        log([&]() { return std::format("Finished with {} ({}) samples", sample_count, valid_sample_count); }, log_level, LOG_BASIC);
+        if (surrogate_size != 0) {
+            log([&]{ return std::format("Surrogate skipped {} trials; of those simulated, {} of {} predicted to lose did, {} of {} predicted to win did",
+                                        surrogate_skipped.load(), surrogate_correct[0].load(), surrogate_checked[0].load(),
+                                        surrogate_correct[1].load(), surrogate_checked[1].load()); }, log_level, LOG_BASIC);
+        }
+    }
 
-                        // Center around best arg, but clamp to original hard bounds
-                        cur_lower_bounds[d] = std::max(lower_bounds[d], best_arg[d] - current_span / 2.f);
-                        cur_upper_bounds[d] = std::min(upper_bounds[d], best_arg[d] + current_span / 2.f);
-                    }
+    // one axis of a grid_search() lattice, setting dimensions [first_dim, first_dim + size of its points)
+    // axes covering several dimensions at once can hold lattices that aren't products of per-dimension steps
+    struct grid_axis {
+        size_t first_dim;
+        std::vector<std::vector<float>> points;
+    };
 
-                    log([&]{ return std::format("New bounds: [{}] to [{}]", vec_to_str(cur_lower_bounds), vec_to_str(cur_upper_bounds)); }, log_level, LOG_INFO);
+    // the lattice lower + k * step within bounds, one axis per dimension, fixed dimensions take their single value
+    std::vector<grid_axis> grid_axes(const std::vector<float>& steps) const {
+        size_t dims = lower_bounds.size();
+        std::vector<grid_axis> axes(dims);
+        for (size_t i = 0; i < dims; ++i) {
+            size_t count = 1;
+            if (!fixed_dims[i] && steps[i] > 0.f) {
+                // small epsilon so that FP error doesn't drop the upper bound
+                count = (size_t)std::floor((upper_bounds[i] - lower_bounds[i]) / steps[i] + 1e-3f) + 1;
+            }
+            axes[i].first_dim = i;
+            axes[i].points.resize(count);
+            for (size_t k = 0; k < count; ++k) {
+                axes[i].points[k] = {std::min(upper_bounds[i], lower_bounds[i] + k * steps[i])};
+            }
+        }
+        return axes;
+    }
+
+    // returns 0 on overflow
+    static size_t grid_size(const std::vector<grid_axis>& axes) {
+        size_t total = 1;
+        for (const grid_axis& axis : axes) {
+            size_t count = axis.points.size();
+            if (count != 0 && total > std::numeric_limits<size_t>::max() / count) return 0;
+            total *= count;
+        }
+        return total;
+    }
+
+    size_t grid_size(const std::vector<float>& steps) const {
+        return grid_size(grid_axes(steps));
+    }
+
+    // Exhaustive search over the lattice given by steps
+    // guarantees the best result on the lattice, so only feasible for low-dimensional problems or coarse steps
+    bool grid_search(const std::vector<float>& steps, size_t top_k = 1) {
+        return grid_search(grid_axes(steps), top_k);
+    }
+
+    // Exhaustive search over every combination of the axes' points, which have to cover every dimension
+    // returns false if cancelled before scanning all of them, in which case results are only the best of what was scanned
+    bool grid_search(const std::vector<grid_axis>& axes, size_t top_k = 1) {
+        size_t total = grid_size(axes);
+        size_t dims = lower_bounds.size();
+        // points are handed out in chunks to keep contention on the counter low
+        const size_t chunk_size = 256;
+
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<size_t> done_count{0}, valid_count{0};
+        std::vector<std::vector<std::pair<std::vector<float>, R>>> thread_tops(n_threads);
+
+        auto worker = [&](size_t thread_idx) {
+            std::vector<float> at(dims);
+            std::vector<std::pair<std::vector<float>, R>>& tops = thread_tops[thread_idx];
+            while (!cancelled()) {
+                size_t from = next_chunk.fetch_add(1) * chunk_size;
+                if (from >= total) break;
+                size_t to = std::min(total, from + chunk_size);
+                size_t valid = 0;
+                for (size_t idx = from; idx < to; ++idx) {
+                    // decode mixed-radix index into lattice point
+                    size_t rem = idx;
+                    for (const grid_axis& axis : axes) {
+                        const std::vector<float>& point = axis.points[rem % axis.points.size()];
+                        std::copy(point.begin(), point.end(), at.begin() + axis.first_dim);
+                        rem /= axis.points.size();
+                    }
+                    R res = funct(at, args);
+                    valid += res.valid();
+                    insert_top(tops, at, res, top_k);
                 }
+                done_count += to - from;
+                valid_count += valid;
+            }
+        };
+
+        time_point_t start_time = main_clock.now();
+        std::vector<size_t> counts;
+        for (const grid_axis& axis : axes) counts.push_back(axis.points.size());
+        log([&]{ return std::format("Scanning {} grid points ({} per axis)", total, vec_to_str(counts)); }, log_level, LOG_BASIC);
+
+        std::vector<std::thread> threads;
+        if (n_threads > 1) {
+            for (size_t i = 0; i < n_threads; ++i) {
+                threads.emplace_back(worker, i);
+            }
+            // report progress while the workers go
+            while (done_count < total && !cancelled()) {
+                std::this_thread::sleep_for(poll_spacing);
+                float elapsed = to_seconds(main_clock.now() - start_time);
+                log([&]{ return std::format("{}/{} ({} valid) points ({:.0f} points/s)", done_count.load(), total, valid_count.load(), done_count / elapsed); },
+                    log_level, LOG_INFO, false);
+                std::flush(std::cout);
             }
+        } else {
+            worker(0);
         }
+        for (std::thread& t : threads) t.join();
 
-        log([&]() { return std::format("Finished with {} ({}) samples", sample_count, valid_sample_count); }, log_level, LOG_BASIC);
+        top_results.clear();
+        for (const auto& tops : thread_tops) {
+            for (const auto& [at, res] : tops) {
+                insert_top(top_results, at, res, top_k);
+            }
+        }
+        eval_count += done_count;
+        if (!top_results.empty() && better_than(top_results[0].second, best_result, maximise)) {
+            best_arg = top_results[0].first;
+            best_result = top_results[0].second;
+        }
+
+        float elapsed = to_seconds(main_clock.now() - start_time);
+        log([&]{ return std::format("Scanned {} ({} valid) of {} grid points in {:.3f}s ({:.0f} points/s)",
+                                    done_count.load(), valid_count.load(), total, elapsed, done_count / elapsed); }, log_level, LOG_BASIC);
+        return done_count == total;
+    }
+
+    // largest difference between two points in any non-fixed dimension, as a fraction of the width of its bounds
+    float arg_distance(const std::vector<float>& lhs, const std::vector<float>& rhs) const {
+        float dist = 0.f;
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (fixed_dims[i]) continue;
+            dist = std::max(dist, std::abs(lhs[i] - rhs[i]) / (upper_bounds[i] - lower_bounds[i]));
+        }
+        return dist;
+    }
+
+    // inserts a result into a best-first list of at most max_size, dropping worse ones within top_distance of it
+    // the distance check is inclusive, so a top_distance of 0 only keeps out repeats of the same point
+    // returns where it went, or max_size if it wasn't good enough
+    size_t insert_top(std::vector<std::pair<std::vector<float>, R>>& tops, const std::vector<float>& at, const R& res, size_t max_size) const {
+        if (!res.valid() || pruned(res)) return max_size;
+        if (tops.size() >= max_size && !better_than(res, tops.back().second, maximise)) return max_size;
+        for (const auto& [top_at, top_res] : tops) {
+            if (!better_than(res, top_res, maximise) && arg_distance(at, top_at) <= top_distance) return max_size;
+        }
+        std::erase_if(tops, [&](const auto& p){ return arg_distance(at, p.first) <= top_distance; });
+        auto it = std::find_if(tops.begin(), tops.end(), [&](const auto& p){ return better_than(res, p.second, maximise); });
+        size_t idx = it - tops.begin();
+        tops.insert(it, {at, res});
+        if (tops.size() > max_size) tops.pop_back();
+        return idx;
+    }
+
+    // results cut short before being fully rated, if R has such, are valid but rank below any that weren't
+    // and never become a best result themselves
+    static bool pruned(const R& res) {
+        if constexpr (requires { res.pruned(); }) {
+            return res.pruned();
+        } else {
+            return false;
+        }
     }
 
     static bool better_than(const R& what, const R& than, bool maximise) {
-        if (!than.valid()) return what.valid();
-        if (!what.valid()) return false;
+        if (!what.valid() || pruned(what)) return false;
+        if (!than.valid() || pruned(than)) return true;
         return maximise ? what > than : than > what;
     }
 
+    // whether what is better than than by more than eps
+    static bool improves_by(const R& what, const R& than, float eps, bool maximise) {
+        if (!what.valid() || pruned(what)) return false;
+        if (!than.valid() || pruned(than)) return true;
+        float diff = what.rating() - than.rating();
+        return (maximise ? diff : -diff) > eps;
+    }
+
+    // unlike better_than, lets pruned results replace invalid ones, so populations keep evolving where it's valid
     static bool better_eq_than(const R& what, const R& than, bool maximise) {
         if (!than.valid()) return true;
-        if (!what.valid()) return !than.valid();
+        if (!what.valid()) return false;
+        if (pruned(what) || pruned(than)) return pruned(than);
         return maximise ? what >= than : than >= what;
     }
 };
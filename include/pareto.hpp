@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+// Multi-objective search: NSGA-II selection on top of the same DE/rand/1/bin step optimiser uses
+// instead of a single best result, finds the front of results no other result beats in every objective
+template<typename T, typename R>
+struct pareto_optimiser {
+    std::function<R(const std::vector<float>&, const T&)> funct;
+    T args;
+    // objective values of a valid result, all to be maximised, so negate ones that should be minimised
+    std::function<std::vector<float>(const R&)> objectives;
+    std::vector<float> lower_bounds;
+    std::vector<float> upper_bounds;
+    duration_t max_duration;
+    size_t log_level;
+    size_t n_threads = 1;
+    // if set, evaluations run on this instead of a pool of our own
+    thread_pool* pool = nullptr;
+
+    // total amount of function evaluations per find_front() call, 0 for no limit
+    size_t max_evals = 0;
+    size_t pop_size = 100;
+    // continuous objectives can have endless non-dominated results, past this many the most crowded ones get dropped
+    size_t max_front = 100;
+    float mutation_factor = 0.6f;
+    float crossover_prob = 0.9f;
+
+    struct point {
+        std::vector<float> arg;
+        R result;
+        std::vector<float> obj;
+        // 0 for the non-dominated front, 1 for what's non-dominated once that's removed, etc.
+        size_t rank = 0;
+        float crowding = 0.f;
+    };
+
+    // every non-dominated result found so far, sorted by the first objective, best first
+    std::vector<point> front;
+    size_t eval_count = 0;
+
+    pareto_optimiser(std::function<R(const std::vector<float>&, T)> func,
+                     std::function<std::vector<float>(const R&)> objectives,
+                     const std::vector<float>& lowerb,
+                     const std::vector<float>& upperb,
+                     T i_args,
+                     duration_t i_max_duration,
+                     size_t log_level = LOG_NONE)
+    :
+        funct(func),
+        args(i_args),
+        objectives(objectives),
+        lower_bounds(lowerb),
+        upper_bounds(upperb),
+        max_duration(i_max_duration),
+        log_level(log_level) {
+
+        if (lowerb.size() != upperb.size()) {
+            throw std::runtime_error("optimiser parameters have mismatched dimensions");
+        }
+        for (size_t i = 0; i < lowerb.size(); ++i) {
+            if (lowerb[i] > upperb[i]) {
+                throw std::runtime_error("optimiser upper bound " + std::to_string(i) + " was smaller than lower bound");
+            }
+        }
+    }
+
+    // whether lhs is at least as good as rhs in every objective and better in at least one
+    static bool dominates(const point& lhs, const point& rhs) {
+        if (!rhs.result.valid()) return lhs.result.valid();
+        if (!lhs.result.valid()) return false;
+        bool better = false;
+        for (size_t i = 0; i < lhs.obj.size(); ++i) {
+            if (lhs.obj[i] < rhs.obj[i]) return false;
+            better |= lhs.obj[i] > rhs.obj[i];
+        }
+        return better;
+    }
+
+    void find_front() {
+        std::unique_ptr<thread_pool> own_pool;
+        if (!pool) {
+            own_pool = std::make_unique<thread_pool>(n_threads);
+        }
+        thread_pool& eval_pool = pool ? *pool : *own_pool;
+
+        size_t dims = lower_bounds.size();
+        pop_size = std::max(pop_size, (size_t)4);
+        std::mt19937 rng(std::random_device{}());
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        auto pick = [&](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); };
+
+        front.clear();
+        eval_count = 0;
+        time_point_t end_time = main_clock.now() + max_duration;
+
+        std::vector<point> population(pop_size);
+        for (point& p : population) {
+            p.arg = random_vec(lower_bounds, upper_bounds);
+        }
+        evaluate(population, eval_pool);
+        add_to_front(population);
+
+        std::vector<point> offspring(pop_size);
+        size_t generation = 0;
+        while (main_clock.now() < end_time && !status_SIGINT && (max_evals == 0 || eval_count < max_evals)) {
+            // DE/rand/1/bin trial for every member, mutants are a + F * (b - c)
+            for (size_t i = 0; i < pop_size; ++i) {
+                size_t a, b, c;
+                do { a = pick(pop_size); } while (a == i);
+                do { b = pick(pop_size); } while (b == i || b == a);
+                do { c = pick(pop_size); } while (c == i || c == a || c == b);
+                size_t forced = pick(std::max(dims, (size_t)1));
+                std::vector<float>& trial = offspring[i].arg;
+                trial = population[i].arg;
+                for (size_t j = 0; j < dims; ++j) {
+                    if (lower_bounds[j] == upper_bounds[j]) continue;
+                    if (unit(rng) < crossover_prob || j == forced) {
+                        float val = population[a].arg[j] + mutation_factor * (population[b].arg[j] - population[c].arg[j]);
+                        trial[j] = std::clamp(val, lower_bounds[j], upper_bounds[j]);
+                    }
+                }
+            }
+            if (max_evals != 0) {
+                offspring.resize(std::min(pop_size, max_evals - eval_count));
+            }
+            evaluate(offspring, eval_pool);
+            add_to_front(offspring);
+
+            // NSGA-II survival: best ranks first, ties broken by preferring less crowded points
+            population.insert(population.end(), std::make_move_iterator(offspring.begin()), std::make_move_iterator(offspring.end()));
+            assign_ranks(population);
+            std::sort(population.begin(), population.end(), [](const point& lhs, const point& rhs) {
+                return lhs.rank != rhs.rank ? lhs.rank < rhs.rank : lhs.crowding > rhs.crowding;
+            });
+            population.resize(pop_size);
+            offspring.resize(pop_size);
+
+            ++generation;
+            log([&]{ return std::format("Generation {}: {} samples, front of {}", generation, eval_count, front.size()); }, log_level, LOG_INFO, false);
+        }
+
+        std::sort(front.begin(), front.end(), [](const point& lhs, const point& rhs) { return lhs.obj[0] > rhs.obj[0]; });
+        log([&]{ return std::format("Finished with {} samples over {} generations, front of {}", eval_count, generation, front.size()); }, log_level, LOG_BASIC);
+    }
+
+private:
+    void evaluate(std::vector<point>& points, thread_pool& eval_pool) {
+        eval_pool.parallel_for(points.size(), [&](size_t i) {
+            point& p = points[i];
+            p.result = funct(p.arg, args);
+            p.obj = p.result.valid() ? objectives(p.result) : std::vector<float>();
+        });
+        eval_count += points.size();
+    }
+
+    // keeps front non-dominated, results with the same objectives as one already there are dropped
+    void add_to_front(const std::vector<point>& points) {
+        for (const point& p : points) {
+            if (!p.result.valid()) continue;
+            bool dominated = std::any_of(front.begin(), front.end(), [&](const point& f) {
+                return dominates(f, p) || f.obj == p.obj;
+            });
+            if (dominated) continue;
+            std::erase_if(front, [&](const point& f) { return dominates(p, f); });
+            front.push_back(p);
+            if (front.size() > max_front) {
+                std::vector<size_t> layer(front.size());
+                std::iota(layer.begin(), layer.end(), 0);
+                assign_crowding(front, layer);
+                front.erase(std::min_element(front.begin(), front.end(), [](const point& lhs, const point& rhs) { return lhs.crowding < rhs.crowding; }));
+            }
+        }
+    }
+
+    // fast non-dominated sort and crowding distance
+    static void assign_ranks(std::vector<point>& points) {
+        size_t n = points.size();
+        std::vector<std::vector<size_t>> dominated_by_us(n);
+        std::vector<size_t> dominating_count(n, 0);
+        std::vector<size_t> current;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = i + 1; j < n; ++j) {
+                if (dominates(points[i], points[j])) {
+                    dominated_by_us[i].push_back(j);
+                    ++dominating_count[j];
+                } else if (dominates(points[j], points[i])) {
+                    dominated_by_us[j].push_back(i);
+                    ++dominating_count[i];
+                }
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (dominating_count[i] == 0) current.push_back(i);
+        }
+
+        size_t rank = 0;
+        while (!current.empty()) {
+            std::vector<size_t> next;
+            for (size_t i : current) {
+                points[i].rank = rank;
+                for (size_t j : dominated_by_us[i]) {
+                    if (--dominating_count[j] == 0) next.push_back(j);
+                }
+            }
+            assign_crowding(points, current);
+            current = std::move(next);
+            ++rank;
+        }
+    }
+
+    // sum over objectives of the normalised gap between each point's neighbours, edges get the most a float can hold
+    // rather than infinity, which -ffast-math can't compare
+    static void assign_crowding(std::vector<point>& points, std::vector<size_t>& layer) {
+        for (size_t i : layer) points[i].crowding = 0.f;
+        if (!points[layer[0]].result.valid()) return;
+        size_t n_obj = points[layer[0]].obj.size();
+        for (size_t m = 0; m < n_obj; ++m) {
+            std::sort(layer.begin(), layer.end(), [&](size_t lhs, size_t rhs) { return points[lhs].obj[m] < points[rhs].obj[m]; });
+            float lo = points[layer.front()].obj[m], hi = points[layer.back()].obj[m];
+            points[layer.front()].crowding = points[layer.back()].crowding = std::numeric_limits<float>::max();
+            if (hi <= lo) continue;
+            for (size_t k = 1; k + 1 < layer.size(); ++k) {
+                points[layer[k]].crowding += (points[layer[k + 1]].obj[m] - points[layer[k - 1]].obj[m]) / (hi - lo);
+            }
+        }
+    }
+};
+
+}
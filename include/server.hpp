@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+// long-running server reading JSON requests line by line, so callers don't pay process startup per query
+// every request is a flat JSON object with an "op", and an optional "id" which gets echoed in its reply:
+//   {"op":"simulate","recipe":"<serialised>"}
+//   {"op":"tolerance","recipe":"<serialised>","tol":0.95}
+//   {"op":"optimise","mix":["plasma","tritium"],"primer":["oxygen"],"mixt":[375.15,595.15],"thirt":[293.15,293.15],"runtime":3,"maxevals":0}
+//     optionally with "seed":[...], the "arg" of an earlier optimise reply to start from
+//     and "mixtosolve":true to solve the mix-to temperature per candidate, see target_solve_args
+//     other fields are named after the atmosim flags they match, e.g. "robust":[temp,pressure,ratio%], "screen":[ticks,...],
+//     "init":"sobol", "stallgens", "restarts", "surrogate", "sensitivity" and "ratiolower"/"ratioupper" for --ratiobounds
+//   {"op":"cancel","job":<id of a running job>}
+//   {"op":"stats"}
+//   {"op":"shutdown"}
+// replies are one JSON object per line, with an "error" if the request failed
+// jobs run concurrently on a shared thread pool so replies may come out of order
+struct server {
+    // n_threads workers run jobs, the thread calling serve() only reads requests
+    server(size_t n_threads, std::ostream& out);
+
+    // handle requests until EOF or shutdown, then wait for running jobs
+    void serve(std::istream& in);
+
+private:
+    struct job {
+        std::atomic<bool> cancel{false};
+    };
+
+    // returns false on shutdown
+    bool handle(std::string_view line);
+    void reply(const std::string& id_json, std::string body);
+    void submit_job(const std::string& id_json, std::function<std::string(const std::atomic<bool>&)> fn);
+
+    std::string optimise(const json_object& req, const std::atomic<bool>& cancel);
+
+    std::ostream& out;
+    std::mutex out_mutex;
+
+    // running jobs, by their id's JSON text
+    std::map<std::string, std::shared_ptr<job>> jobs;
+    size_t running = 0;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+
+    // replies to deterministic requests, cleared when full
+    std::unordered_map<std::string, std::string> result_cache;
+    size_t max_cache_size = 4096;
+    std::mutex cache_mutex;
+
+    std::atomic<size_t> jobs_done{0}, cache_hits{0};
+
+    // last so it's destroyed first, after every job is done
+    thread_pool pool;
+};
+
+}
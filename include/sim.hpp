@@ -1,12 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <argparse/read.hpp>
 
 #include "gas.hpp"
 #include "tank.hpp"
+#include "thread_pool.hpp"
 #include "utility.hpp"
 
 namespace asim {
@@ -79,14 +88,112 @@ inline std::istream& operator>>(std::istream& stream, field_restriction<T>& re)
 
 extern std::string params_supported_str;
 
+struct bomb_data;
+struct screen_args;
+
+// an input parameter of a recipe that can be varied, e.g. for measuring tolerances
+struct recipe_param {
+    enum param_type {fuel_temp_p, fuel_pressure_p, thir_temp_p, to_pressure_p, mix_ratio_p, primer_ratio_p};
+
+    param_type type;
+    // gas index for ratio parameters
+    size_t index = 0;
+
+    float& of(bomb_data& data) const;
+    float of(const bomb_data& data) const;
+
+    // human-readable name, e.g. "Fuel temp" or "Mix plasma"
+    std::string name(const bomb_data& data) const;
+    // short name matching the serialised format, e.g. "ft" or "mi0"
+    std::string key() const;
+    // how finely this parameter is rounded, 0 if it isn't
+    float round_step(const bomb_data& data) const;
+
+    // inverse of key(), throws on unknown keys
+    static recipe_param from_key(std::string_view key);
+};
+
+// range within which varying a parameter alone keeps the bomb within tolerance
+// ratios are given as fractions of their mix
+struct param_tolerance {
+    recipe_param param;
+    float min_v, max_v;
+};
+
+// how far each kind of parameter gets randomly perturbed when estimating joint robustness
+struct mismix_dist {
+    float temp_width = 0.5f; // K
+    float pressure_width = 5.f; // kPa
+    float ratio_width = 0.005f; // fraction of the mix
+    // normal distributions use the width as standard deviation, uniform ones as maximum deviation
+    bool uniform = false;
+
+    float width(recipe_param param) const;
+};
+
+// outcome of randomly mismixing a bomb many times
+struct robustness_report {
+    struct param_sensitivity {
+        recipe_param param;
+        // success rates among samples where this parameter ended up below and above its nominal value
+        float success_below, success_above;
+    };
+
+    size_t samples = 0, successes = 0;
+    // 95% Wilson score interval for the success probability
+    float ci_low = 0.f, ci_high = 0.f;
+    std::vector<param_sensitivity> sensitivity;
+
+    float success_rate() const {
+        return samples == 0 ? 0.f : (float)successes / samples;
+    }
+};
+
+// simulated outcomes of a recipe over a grid of two of its parameters, to show how they interact
+// ratio parameters are fractions of their mix
+struct validity_map {
+    recipe_param x_param, y_param;
+    float x_min = 0.f, x_max = 0.f, y_min = 0.f, y_max = 0.f;
+    size_t width = 0, height = 0;
+    // row-major, indexed by y * width + x
+    std::vector<float> radius;
+    std::vector<int> ticks;
+    std::vector<char> valid;
+
+    float x_at(size_t x) const {
+        return width < 2 ? x_min : x_min + (x_max - x_min) * x / (width - 1);
+    }
+    float y_at(size_t y) const {
+        return height < 2 ? y_min : y_min + (y_max - y_min) * y / (height - 1);
+    }
+
+    // CSV with a header of the parameter keys, then one x,y,radius,ticks,valid row per point
+    void write_csv(std::ostream& stream) const;
+    static validity_map read_csv(std::istream& stream);
+};
+
+// fixed-layout binary form of what serialize() stores, for bulk storage; native endianness
+struct recipe_record {
+    static constexpr size_t max_gases = 16;
+
+    float fuel_temp, fuel_pressure, to_pressure, thir_temp;
+    uint8_t mix_count, primer_count;
+    uint8_t reserved[2];
+    // gas indices, mix gases first, unused ones are 0xff
+    uint8_t gases[max_gases];
+    // fractions of their mix, same order as gases
+    float fractions[max_gases];
+};
+static_assert(std::is_trivially_copyable_v<recipe_record> && sizeof(recipe_record) == 100);
+
 struct bomb_data {
     std::vector<float> mix_ratios, primer_ratios;
     float to_pressure, fuel_temp, fuel_pressure, thir_temp, mix_to_temp;
     std::vector<gas_ref> mix_gases, primer_gases;
     gas_tank tank;
-    float optstat;
+    float optstat = 0.f;
     float fin_pressure = 0.f, fin_radius = 0.f;
-    int ticks;
+    int ticks = 0;
     float round_pressure_to, round_temp_to, round_ratio_to;
 
     // TODO: make this more sane somehow?
@@ -102,7 +209,8 @@ struct bomb_data {
         tank(tank),
         round_pressure_to(round_pressure_to), round_temp_to(round_temp_to), round_ratio_to(round_ratio_to) {};
 
-    void sim_ticks(size_t up_to, field_ref<bomb_data> optstat_ref, bool measure_pre);
+    // returns false if screening cut the simulation short, leaving us only partially simulated
+    bool sim_ticks(size_t up_to, field_ref<bomb_data> optstat_ref, bool measure_pre, const screen_args* screen = nullptr);
 
     std::string mix_string(const std::vector<gas_ref>& gases, const std::vector<float>& fractions) const;
     std::string mix_string_simple(const std::vector<gas_ref>& gases, const std::vector<float>& fractions) const;
@@ -111,10 +219,39 @@ struct bomb_data {
     std::string print_full() const;
 
     std::string serialize() const;
+    // JSON object of our results and serialised recipe, extra_fields get prepended as-is if given, e.g. "\"line\":1"
+    std::string to_json(std::string_view extra_fields = {}) const;
     // deserialises us from an input string - note that this gives an unsimulated tank
     static bomb_data deserialize(std::string_view str);
-
-    std::string measure_tolerances(float tol = default_tol) const;
+    recipe_record to_record() const;
+    // likewise gives an unsimulated tank
+    static bomb_data from_record(const recipe_record& rec);
+
+    // every parameter of this recipe, ratios only included if their mix has more than one gas
+    std::vector<recipe_param> params() const;
+    // fill a fresh tank according to our parameters
+    gas_tank build_tank() const;
+    // same, but with the given parameters changed
+    gas_tank build_tank(std::span<const std::pair<recipe_param, float>> changes) const;
+    // simulate with one parameter changed, returns whether we still reach the target radius and ticks
+    bool test_variation(recipe_param param, float value, float target_radius, float target_ticks, size_t tick_limit) const;
+
+    std::vector<param_tolerance> tolerances(float tol, thread_pool& pool) const;
+    std::string measure_tolerances(float tol = default_tol, size_t n_threads = 1) const;
+    std::string measure_tolerances(float tol, thread_pool& pool) const;
+
+    // perturbs every parameter at once according to dist, counting how many samples still reach tol times our radius and ticks
+    // results depend only on seed, not on the thread count
+    robustness_report robustness(size_t samples, const mismix_dist& dist, float tol, thread_pool& pool, uint64_t seed = 0) const;
+    std::string measure_robustness(size_t samples, const mismix_dist& dist, float tol = default_tol, size_t n_threads = 1) const;
+
+    // simulate every combination of two parameters over the given ranges, marking which reach tol times our radius and ticks
+    // ratio parameters range over fractions of their mix, as tolerances() gives them
+    validity_map map_validity(recipe_param x_param, float x_min, float x_max, size_t width,
+                              recipe_param y_param, float y_min, float y_max, size_t height,
+                              float tol, thread_pool& pool) const;
+    // range worth mapping for a parameter: its tolerance range, extended by half its width on both sides
+    std::pair<float, float> map_range(recipe_param param, float tol, thread_pool& pool) const;
 
     static const field_ref<bomb_data> radius_field;
     static const field_ref<bomb_data> ticks_field;
@@ -124,11 +261,15 @@ struct bomb_data {
 };
 
 std::istream& operator>>(std::istream& stream, field_ref<bomb_data>& re);
+// the name operator>> takes for a field, throws if it has none
+std::string field_name(const field_ref<bomb_data>& field);
 
 // wrapper for bomb_data for use by the optimiser
 struct opt_val_wrap {
     std::shared_ptr<bomb_data> data = nullptr;
     bool valid_v = true;
+    // cut short before it could be fully rated, e.g. by robust_args pruning: still valid, but worse than anything that wasn't
+    bool pruned_v = false;
 
     opt_val_wrap(): valid_v(false) {}
     opt_val_wrap(std::shared_ptr<bomb_data>& d): data(d), valid_v(d != nullptr) {}
@@ -137,6 +278,9 @@ struct opt_val_wrap {
     bool valid() const {
         return valid_v;
     }
+    bool pruned() const {
+        return pruned_v;
+    }
     float rating() const {
         return valid() ? data->optstat : 0.f;
     }
@@ -155,6 +299,79 @@ struct opt_val_wrap {
     }
 };
 
+// robustness-aware objective: rate bombs by their worst or quantile optstat over a stencil of mismixes
+// each recipe parameter is perturbed by +-its delta one at a time, so the stencil is 2 points per parameter
+struct robust_args {
+    float temp_delta = 0.f; // K
+    float pressure_delta = 0.f; // kPa
+    float ratio_delta = 0.f; // fraction of the mix
+    // which quantile of the stencil outcomes to rate by, 0 for worst-case
+    float quantile = 0.f;
+    bool maximise = true;
+    // best robust rating seen so far, negated if minimising, used to prune candidates which can't beat it
+    // lowest() rather than -infinity, which -ffast-math can't compare against
+    mutable std::atomic<float> best_rating{std::numeric_limits<float>::lowest()};
+
+    bool enabled() const {
+        return temp_delta > 0.f || pressure_delta > 0.f || ratio_delta > 0.f;
+    }
+    // forget best_rating, for a new search
+    void reset() const {
+        best_rating.store(std::numeric_limits<float>::lowest(), std::memory_order_relaxed);
+    }
+};
+
+// multi-fidelity screening for long tick caps: candidates are simulated in stages up to increasing tick horizons,
+// and after each only go on if their projected pressure is within the best keep_fraction of those seen at that horizon
+// whatever makes it past every stage is simulated exactly as it would be without screening, so screening only ever discards
+// discarded candidates come out pruned, see opt_val_wrap
+struct screen_args {
+    std::vector<size_t> horizons;
+    float keep_fraction = 1.f / 3.f;
+    // every stage lets this many candidates through before it starts discarding, then updates its threshold every 32
+    size_t warmup = 64;
+
+    screen_args(std::vector<size_t> horizons = {}, float keep_fraction = 1.f / 3.f);
+
+    bool enabled() const {
+        return !horizons.empty();
+    }
+    // records a candidate's score at a stage, returns whether it should be simulated further
+    bool promote(size_t stage, float score) const;
+    size_t discarded() const {
+        return discarded_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct stage_state {
+        std::mutex mutex;
+        // the most recent scores, as a ring buffer
+        std::vector<float> recent;
+        size_t seen = 0;
+        std::atomic<float> threshold{std::numeric_limits<float>::lowest()};
+    };
+    std::unique_ptr<stage_state[]> stages;
+    mutable std::atomic<size_t> discarded_count{0};
+};
+
+// solving mix-to temperature per candidate instead of searching over it: do_sim then ignores its target_temp arg
+// and searches the rounding grid between lower and upper, and the fuel and primer temps, for the best optstat:
+// an even scan brackets the best peak, which a golden-section search then refines
+// optstat tends to be jagged in target temperature, so this finds a good local peak rather than the best one
+// only the temperature found gets robustness rating and screening
+struct target_solve_args {
+    float lower = 0.f, upper = 0.f;
+    bool maximise = true;
+    // grid spacing to search on if temperatures aren't rounded
+    float resolution = 0.1f;
+    // points of the bracketing scan, including both ends
+    size_t scan_points = 8;
+
+    bool enabled() const {
+        return upper > lower;
+    }
+};
+
 struct bomb_args {
     const std::vector<gas_ref>& mix_gases;
     const std::vector<gas_ref>& primer_gases;
@@ -166,10 +383,24 @@ struct bomb_args {
     field_ref<bomb_data> opt_param;
     const std::vector<field_restriction<bomb_data>>& pre_restrictions;
     const std::vector<field_restriction<bomb_data>>& post_restrictions;
+    // null or disabled to optimise the nominal optstat
+    const robust_args* robust = nullptr;
+    // null or disabled to always simulate up to tick_cap
+    const screen_args* screen = nullptr;
+    // null or disabled to take target_temp as given
+    const target_solve_args* solve_target = nullptr;
 };
 
 // args: target_temp, fuel_temp, thir_temp, mix ratios..., primer ratios...
 opt_val_wrap do_sim(const std::vector<float>& in_args, const bomb_args& args);
+// inverse of do_sim: its input args for a recipe, with ratios for the given gases
+// gases the recipe lacks get very small ratios, usually below the optimiser's bounds, which moves them up to the smallest share it allows;
+// ones it has beyond those are left out
+std::vector<float> recipe_args(const bomb_data& recipe, const std::vector<gas_ref>& mix_gases, const std::vector<gas_ref>& primer_gases);
+// do_sim log-ratio args for every split of a mix of ratio_lower.size() + 1 gases into whole round_ratio_to steps within the bounds,
+// so each is a different recipe after rounding; gives up after max_points + 1 of them
+std::vector<std::vector<float>> ratio_lattice(const std::vector<float>& ratio_lower, const std::vector<float>& ratio_upper,
+                                              float round_ratio_to, size_t max_points);
 
 }
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "gas.hpp"
+#include "sim.hpp"
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+struct sweep_options {
+    // gases combinations are made of, every combination uses a gas at most once between its mix and primer
+    std::vector<gas_ref> gases;
+    size_t max_mix_gases = 2, max_primer_gases = 2;
+    // bounds of target temp, fuel temp, thir temp and pressure, ratio bounds get added per combination
+    std::vector<float> lower_bounds, upper_bounds;
+    float ratio_bound = 3.f;
+    bool maximise = true;
+    bool measure_before = false;
+    float round_pressure_to = 0.1f, round_temp_to = 0.01f, round_ratio_to = 0.00001f;
+    size_t tick_cap = std::numeric_limits<size_t>::max();
+    field_ref<bomb_data> opt_param = bomb_data::radius_field;
+    std::vector<field_restriction<bomb_data>> pre_restrictions, post_restrictions;
+    // wall time of the whole sweep, every halving rung gets an equal share
+    float total_seconds = 60.f;
+    size_t sample_rounds = 5;
+    float bounds_scale = 0.5f;
+    size_t log_level = LOG_NONE;
+};
+
+struct sweep_result {
+    std::vector<gas_ref> mix_gases, primer_gases;
+    opt_val_wrap best;
+    // how many rungs this combination was optimised in before being dropped
+    size_t rungs = 0;
+    float seconds = 0.f;
+};
+
+// successive halving over every mix/primer combination: all of them get a short optimisation,
+// then the worse half is dropped and the rest continue from their best for twice as long, until one is left
+// results are sorted by how far they got, then by best result
+std::vector<sweep_result> sweep_gases(const sweep_options& opts, thread_pool& pool);
+
+}
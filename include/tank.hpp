@@ -21,11 +21,15 @@ struct gas_tank {
     // simulate until the tank is no longer intact, up to ticks_limit ticks
     // returns: how many ticks we went forward
     size_t tick_n(size_t ticks_limit);
+    // same, stopped tells whether we stopped early, so the simulation can be resumed with another call if not
+    size_t tick_n(size_t ticks_limit, bool& stopped);
 
     float calc_radius();
     static float calc_radius(float pressure);
 
     std::string get_status();
+    // intact, ruptured or exploded
+    const char* state_name() const;
 };
 
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace asim {
+
+// simple persistent worker pool
+// the calling thread takes part in parallel_for(), so nesting parallel_for() calls inside tasks is safe
+struct thread_pool {
+    // total threads including the caller, so 1 means run everything on the calling thread
+    thread_pool(size_t n_threads);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    // run a detached task on a worker, or immediately if we have no workers
+    void submit(std::function<void()> task);
+
+    // calls fn(i) for every i in [0, n), returns once all calls finished
+    // rethrows the first exception thrown by fn
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+};
+
+}
@@ -3,11 +3,16 @@
 #include <argparse/read.hpp>
 
 #include <csignal>
+#include <cstdint>
 #include <format>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <numeric>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // define this to omit exception checks in hotcode
@@ -28,6 +33,41 @@ long get_float_digits(float num);
 float round_to(float what, float to);
 std::string str_round_to(float what, float to);
 
+// std::isfinite() that -ffast-math can't fold to true, for checking values from outside
+bool is_finite(float num);
+
+// quoted JSON string literal
+std::string json_string(std::string_view str);
+// JSON number, null if not finite
+std::string json_number(float num);
+
+// flat JSON object: scalar values and arrays of scalars, no nesting
+// strings get unescaped, anything else is kept as its source text
+struct json_object {
+    struct scalar {
+        std::string text;
+        bool is_string = false;
+
+        // back to JSON
+        std::string json() const;
+    };
+
+    std::map<std::string, scalar, std::less<>> values;
+    std::map<std::string, std::vector<scalar>, std::less<>> arrays;
+
+    bool has(std::string_view key) const;
+    // these throw if the key is present but of the wrong type, and return def if it's missing
+    std::string get_string(std::string_view key, std::string_view def = {}) const;
+    float get_float(std::string_view key, float def) const;
+    size_t get_size(std::string_view key, size_t def) const;
+    bool get_bool(std::string_view key, bool def) const;
+    std::vector<std::string> get_strings(std::string_view key) const;
+    std::vector<float> get_floats(std::string_view key) const;
+
+    // throws std::runtime_error on malformed or nested input
+    static json_object parse(std::string_view str);
+};
+
 // vec-vec operators
 std::vector<float>& operator+=(std::vector<float>& lhs, const std::vector<float>& rhs);
 std::vector<float>& operator-=(std::vector<float>& lhs, const std::vector<float>& rhs);
@@ -65,6 +105,68 @@ bool vec_in_bounds(const std::vector<float>& vec, const std::vector<float>& lowe
 // tries to rotate input vectors to be spaced apart, expensive
 void space_vectors(std::vector<std::vector<float>>& vecs, float strength);
 
+// low-discrepancy point sets, for covering a search space more evenly than random_vec
+
+// Sobol sequence (Joe-Kuo direction numbers) scrambled with a random digital shift
+// sequences with the same seed are identical, so parallel users should each take disjoint index ranges
+struct sobol_sequence {
+    static const size_t max_dims;
+
+    size_t dims;
+    uint64_t index = 0;
+    std::vector<uint32_t> directions; // 32 per dimension
+    std::vector<uint32_t> shift;
+
+    sobol_sequence(size_t dims, uint64_t seed);
+
+    // get point at index, scaled into bounds
+    // the directions run out after 2^32 points, every further 2^32 repeat them with a different scramble
+    std::vector<float> at(uint64_t idx, const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) const;
+    std::vector<float> next(const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds);
+};
+
+// latin hypercube design of slice_count * slices points, returns the points of slice slice_idx
+// slices drawn with the same seed are disjoint parts of the same design
+std::vector<std::vector<float>> latin_hypercube(size_t slice_count, size_t slices, size_t slice_idx, uint64_t seed,
+                                                const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds);
+
+// rows of equal length in one contiguous block, e.g. a population of optimiser arguments
+// resizing keeps existing rows, and shrinking doesn't give up capacity, so reused matrices stop allocating
+struct float_matrix {
+    size_t cols = 0;
+    std::vector<float> data;
+
+    float_matrix() = default;
+    float_matrix(size_t rows, size_t cols): cols(cols), data(rows * cols, 0.f) {}
+    explicit float_matrix(const std::vector<std::vector<float>>& rows);
+
+    size_t size() const {
+        return cols == 0 ? 0 : data.size() / cols;
+    }
+    bool empty() const {
+        return data.empty();
+    }
+    void clear() {
+        data.clear();
+    }
+    void resize(size_t rows) {
+        data.resize(rows * cols, 0.f);
+    }
+    std::span<float> operator[](size_t row) {
+        return {data.data() + row * cols, cols};
+    }
+    std::span<const float> operator[](size_t row) const {
+        return {data.data() + row * cols, cols};
+    }
+    void set_row(size_t row, std::span<const float> values) {
+        std::copy(values.begin(), values.end(), data.begin() + row * cols);
+    }
+    std::vector<float> row_vec(size_t row) const {
+        return {data.begin() + row * cols, data.begin() + (row + 1) * cols};
+    }
+    std::vector<std::vector<float>> to_rows() const;
+};
+
 inline const size_t LOG_NONE = 0, LOG_BASIC = 1, LOG_INFO = 2, LOG_DEBUG = 3, LOG_TRACE = 4;
 inline std::mutex log_mutex;
 
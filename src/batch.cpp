@@ -0,0 +1,73 @@
+#include <exception>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "sim.hpp"
+#include "utility.hpp"
+
+namespace asim {
+
+std::string simulate_recipe_json(std::string_view recipe, const batch_options& opts, thread_pool& pool) {
+    bomb_data data = bomb_data::deserialize(recipe);
+    data.round_pressure_to = opts.round_pressure_to;
+    data.round_temp_to = opts.round_temp_to;
+    data.round_ratio_to = opts.round_ratio_to;
+    data.ticks = data.tank.tick_n(opts.tick_cap);
+    data.fin_radius = data.tank.calc_radius();
+    data.fin_pressure = data.tank.mix.pressure();
+    data.optstat = data.fin_radius;
+
+    if (!opts.tolerances) return data.to_json();
+    std::string tol_field = "\"tolerances\":{";
+    bool first = true;
+    for (const param_tolerance& tol : data.tolerances(opts.tol, pool)) {
+        if (!first) tol_field += ',';
+        first = false;
+        tol_field += std::format("{}:[{},{}]", json_string(tol.param.key()), json_number(tol.min_v), json_number(tol.max_v));
+    }
+    return data.to_json(tol_field + '}');
+}
+
+static std::string batch_result(std::string_view line, size_t line_n, const batch_options& opts, thread_pool& pool) {
+    std::string line_field = std::format("{{\"line\":{},", line_n);
+    try {
+        // splice the line number in front
+        return line_field + simulate_recipe_json(line, opts, pool).substr(1);
+    } catch (const std::exception& e) {
+        return std::format("{}\"error\":{}}}", line_field, json_string(e.what()));
+    }
+}
+
+size_t run_batch(std::istream& in, std::ostream& out, const batch_options& opts, thread_pool& pool) {
+    size_t chunk_size = opts.chunk_size != 0 ? opts.chunk_size : 64 * pool.size();
+    std::vector<std::pair<size_t, std::string>> lines;
+    std::vector<std::string> results;
+    lines.reserve(chunk_size);
+    size_t line_n = 0, processed = 0;
+    std::string line;
+    bool more = true;
+    while (more && !status_SIGINT) {
+        lines.clear();
+        while (lines.size() < chunk_size && (more = (bool)std::getline(in, line))) {
+            ++line_n;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            lines.emplace_back(line_n, std::move(line));
+        }
+
+        results.assign(lines.size(), {});
+        pool.parallel_for(lines.size(), [&](size_t i) {
+            results[i] = batch_result(lines[i].second, lines[i].first, opts, pool);
+        });
+        for (const std::string& result : results) {
+            out << result << '\n';
+        }
+        out.flush();
+        processed += lines.size();
+    }
+    return processed;
+}
+
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/args.hpp>
+
+#include "atmosim.h"
+#include "constants.hpp"
+#include "gas.hpp"
+#include "optimise.hpp"
+#include "sim.hpp"
+#include "thread_pool.hpp"
+
+using namespace asim;
+
+static_assert(sizeof(atmosim_recipe) == sizeof(recipe_record) && alignof(atmosim_recipe) == alignof(recipe_record));
+static_assert(ATMOSIM_MAX_GASES == recipe_record::max_gases);
+static_assert((int)ATMOSIM_INTACT == gas_tank::st_intact && (int)ATMOSIM_RUPTURED == gas_tank::st_ruptured && (int)ATMOSIM_EXPLODED == gas_tank::st_exploded);
+
+struct atmosim_context {
+    thread_pool pool;
+};
+
+static thread_local std::string last_error;
+
+static void set_error(const char* what) {
+    try {
+        last_error = what;
+    } catch (...) { }
+}
+
+// for anything thrown that isn't a std::exception, which mustn't get past the C ABI either
+static const char* unknown_error = "unknown error";
+
+static size_t tick_limit(uint64_t tick_cap) {
+    return tick_cap == 0 ? std::numeric_limits<size_t>::max() : tick_cap;
+}
+
+static atmosim_result to_result(const bomb_data& data) {
+    return {data.fin_radius, data.fin_pressure, data.tank.mix.temperature, data.ticks, data.tank.state, 0};
+}
+
+static std::vector<gas_ref> to_gases(const uint8_t* indices, uint8_t count) {
+    if (count == 0) throw std::invalid_argument("every mix needs at least one gas");
+    std::vector<gas_ref> gases;
+    for (size_t i = 0; i < count; ++i) {
+        if (indices[i] >= gas_count) throw std::invalid_argument(std::format("invalid gas index {}", indices[i]));
+        gases.push_back({indices[i]});
+    }
+    return gases;
+}
+
+extern "C" {
+
+const char* atmosim_last_error(void) {
+    return last_error.c_str();
+}
+
+size_t atmosim_gas_count(void) {
+    return gas_count;
+}
+
+const char* atmosim_gas_name(size_t index) {
+    return index < gas_count ? gas_types[index].name.c_str() : nullptr;
+}
+
+int atmosim_gas_index(const char* name) {
+    if (name == nullptr) return -1;
+    for (size_t i = 0; i < gas_count; ++i) {
+        if (gas_types[i].name == name) return i;
+    }
+    return -1;
+}
+
+int atmosim_load_config(const char* toml_str, size_t length) {
+    try {
+        if (toml_str == nullptr) throw std::invalid_argument("no config given");
+        load_config(toml::parse(std::string_view(toml_str, length)));
+        return 0;
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return -1;
+    } catch (...) {
+        set_error(unknown_error);
+        return -1;
+    }
+}
+
+atmosim_context* atmosim_create(size_t n_threads) {
+    try {
+        return new atmosim_context{thread_pool(std::max((size_t)1, n_threads))};
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return nullptr;
+    } catch (...) {
+        set_error(unknown_error);
+        return nullptr;
+    }
+}
+
+void atmosim_destroy(atmosim_context* ctx) {
+    delete ctx;
+}
+
+int64_t atmosim_simulate(atmosim_context* ctx, const atmosim_recipe* recipes, atmosim_result* results, size_t count, uint64_t tick_cap) {
+    if (ctx == nullptr || (count != 0 && (recipes == nullptr || results == nullptr))) {
+        set_error("null argument to atmosim_simulate");
+        return -1;
+    }
+    size_t cap = tick_limit(tick_cap);
+    std::atomic<int64_t> invalid = 0;
+    // recipes are simulated on pool threads, but last_error is the caller's
+    std::mutex error_mutex;
+    size_t error_index = count;
+    std::string error;
+    try {
+        ctx->pool.parallel_for(count, [&](size_t i) {
+            auto fail = [&](const char* what) {
+                results[i] = {};
+                results[i].error = 1;
+                ++invalid;
+                std::lock_guard lock(error_mutex);
+                // the first invalid recipe's, whichever thread gets there first
+                if (i < error_index) {
+                    error_index = i;
+                    error = std::format("recipe {}: {}", i, what);
+                }
+            };
+            try {
+                recipe_record rec;
+                std::memcpy(&rec, &recipes[i], sizeof(rec));
+                bomb_data data = bomb_data::from_record(rec);
+                data.ticks = data.tank.tick_n(cap);
+                data.fin_radius = data.tank.calc_radius();
+                data.fin_pressure = data.tank.mix.pressure();
+                results[i] = to_result(data);
+            } catch (const std::exception& e) {
+                fail(e.what());
+            } catch (...) {
+                fail(unknown_error);
+            }
+        });
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return -1;
+    } catch (...) {
+        set_error(unknown_error);
+        return -1;
+    }
+    if (invalid != 0) set_error(error.c_str());
+    return invalid;
+}
+
+void atmosim_optimise_defaults(atmosim_optimise_params* params) {
+    if (params == nullptr) return;
+    *params = {};
+    params->pressure_min = params->pressure_max = pressure_cap;
+    params->lower_target_temp = plasma_fire_temp + 0.1f;
+    params->ratio_bound = 3.f;
+    params->maximise = 1;
+    params->round_temp_to = 0.01f;
+    params->round_pressure_to = 0.1f;
+    params->round_ratio_to = 0.00001f;
+    params->runtime_seconds = 3.f;
+    params->rounds = 5;
+    params->bounds_scale = 0.5f;
+}
+
+int atmosim_optimise(atmosim_context* ctx, const atmosim_optimise_params* params,
+                     atmosim_progress_fn progress, void* user,
+                     atmosim_recipe* best, atmosim_result* best_result) {
+    try {
+        if (ctx == nullptr || params == nullptr || best == nullptr || best_result == nullptr) {
+            throw std::invalid_argument("null argument to atmosim_optimise");
+        }
+        if ((size_t)params->mix_count + params->primer_count > recipe_record::max_gases) {
+            throw std::invalid_argument(std::format("at most {} gases in total are supported", recipe_record::max_gases));
+        }
+        optimise_options opts;
+        opts.mix_gases = to_gases(params->mix_gases, params->mix_count);
+        opts.primer_gases = to_gases(params->primer_gases, params->primer_count);
+        opts.mixt1 = params->mix_temp_min;
+        opts.mixt2 = params->mix_temp_max;
+        opts.thirt1 = params->thir_temp_min;
+        opts.thirt2 = params->thir_temp_max;
+        opts.lower_pressure = params->pressure_min;
+        opts.upper_pressure = params->pressure_max;
+        opts.lower_target_temp = params->lower_target_temp;
+        opts.mix_to_iter = params->mix_to_iter;
+        opts.ratio_bound = params->ratio_bound;
+        opts.tick_cap = tick_limit(params->tick_cap);
+        opts.round_temp_to = params->round_temp_to;
+        opts.round_pressure_to = params->round_pressure_to;
+        // ours is a fraction, the options' a percentage
+        opts.round_ratio_to = params->round_ratio_to * 100.f;
+        if (params->param) opts.opt_param = argp::parse_value<field_ref<bomb_data>>(params->param);
+        opts.maximise = params->maximise;
+        opts.measure_before = params->measure_before;
+        opts.runtime = params->runtime_seconds;
+        opts.rounds = params->rounds;
+        opts.bounds_scale = params->bounds_scale;
+        opts.max_evals = params->max_evals;
+
+        optimise_run run(opts);
+        optimise_run::optimiser_t& optim = run.optim;
+        optim.n_threads = ctx->pool.size();
+        optim.pool = &ctx->pool;
+        std::atomic<bool> cancel = false;
+        optim.cancel_flag = &cancel;
+        if (progress) {
+            optim.on_poll = [&](float fraction) {
+                float best_v = optim.best_result.valid() ? optim.best_result.rating() : NAN;
+                if (progress(fraction, optim.eval_count.load(), best_v, user)) cancel = true;
+            };
+        }
+        optim.find_best();
+
+        if (!optim.best_result.valid()) return 1;
+        recipe_record rec = optim.best_result.data->to_record();
+        std::memcpy(best, &rec, sizeof(rec));
+        *best_result = to_result(*optim.best_result.data);
+        return 0;
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return -1;
+    } catch (...) {
+        set_error(unknown_error);
+        return -1;
+    }
+}
+
+}
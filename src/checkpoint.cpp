@@ -0,0 +1,122 @@
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "checkpoint.hpp"
+
+namespace asim {
+
+static const char* checkpoint_magic = "atmosim_checkpoint";
+static const int checkpoint_version = 1;
+
+static void write_vec(std::ostream& out, const char* label, const std::vector<float>& vec) {
+    out << label << ' ' << vec.size();
+    // shortest representation that reads back to the same float
+    for (float f : vec) out << ' ' << std::format("{}", f);
+    out << '\n';
+}
+
+static void expect(std::istream& in, std::string_view label) {
+    std::string word;
+    if (!(in >> word) || word != label) {
+        throw std::runtime_error(std::format("invalid checkpoint: expected {}, got '{}'", label, word));
+    }
+}
+
+template<typename V>
+static V read_value(std::istream& in, std::string_view label) {
+    expect(in, label);
+    V val;
+    if (!(in >> val)) throw std::runtime_error(std::format("invalid checkpoint: bad value for {}", label));
+    return val;
+}
+
+static std::vector<float> read_vec(std::istream& in, std::string_view label) {
+    size_t count = read_value<size_t>(in, label);
+    std::vector<float> vec(count);
+    for (float& f : vec) {
+        if (!(in >> f)) throw std::runtime_error(std::format("invalid checkpoint: bad value in {}", label));
+    }
+    return vec;
+}
+
+void optimiser_checkpoint::save(const std::string& path) const {
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path);
+        if (!out) throw std::runtime_error("could not open " + tmp_path + " for writing");
+        out << checkpoint_magic << ' ' << checkpoint_version << '\n';
+        out << "key " << std::quoted(key) << '\n';
+        write_vec(out, "lower_bounds", lower_bounds);
+        write_vec(out, "upper_bounds", upper_bounds);
+        out << "init_seed " << init_seed << '\n';
+        out << "round " << round << " in_round " << in_round << " round_elapsed " << std::format("{}", round_elapsed) << '\n';
+        out << "evals " << eval_count << " samples " << sample_count << " valid_samples " << valid_sample_count << " any_valid " << any_valid << '\n';
+        write_vec(out, "cur_lower_bounds", cur_lower_bounds);
+        write_vec(out, "cur_upper_bounds", cur_upper_bounds);
+        write_vec(out, "best_arg", best_arg);
+        write_vec(out, "round_start_arg", round_start_arg);
+        out << "top " << top_args.size() << '\n';
+        for (const auto& arg : top_args) write_vec(out, "arg", arg);
+        out << "samplers " << samplers.size() << '\n';
+        for (const sampler_state& samp : samplers) {
+            out << "pop_size " << samp.pop_size << " restarts " << samp.restarts << " init_count " << samp.init_count
+                << " stall_count " << samp.stall_count << " seed_best " << samp.seed_best << " stalled " << samp.stalled << '\n';
+            out << "rng " << samp.rng << '\n';
+            write_vec(out, "cur_lower_bounds", samp.cur_lower_bounds);
+            write_vec(out, "cur_upper_bounds", samp.cur_upper_bounds);
+            out << "population " << samp.population.size() << '\n';
+            for (const auto& member : samp.population) write_vec(out, "arg", member);
+        }
+        if (!out.flush()) throw std::runtime_error("could not write " + tmp_path);
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+optimiser_checkpoint optimiser_checkpoint::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("could not open checkpoint " + path);
+    if (read_value<int>(in, checkpoint_magic) != checkpoint_version) {
+        throw std::runtime_error("unsupported checkpoint version in " + path);
+    }
+
+    optimiser_checkpoint ck;
+    expect(in, "key");
+    in >> std::quoted(ck.key);
+    ck.lower_bounds = read_vec(in, "lower_bounds");
+    ck.upper_bounds = read_vec(in, "upper_bounds");
+    ck.init_seed = read_value<uint64_t>(in, "init_seed");
+    ck.round = read_value<size_t>(in, "round");
+    ck.in_round = read_value<bool>(in, "in_round");
+    ck.round_elapsed = read_value<float>(in, "round_elapsed");
+    ck.eval_count = read_value<size_t>(in, "evals");
+    ck.sample_count = read_value<size_t>(in, "samples");
+    ck.valid_sample_count = read_value<size_t>(in, "valid_samples");
+    ck.any_valid = read_value<bool>(in, "any_valid");
+    ck.cur_lower_bounds = read_vec(in, "cur_lower_bounds");
+    ck.cur_upper_bounds = read_vec(in, "cur_upper_bounds");
+    ck.best_arg = read_vec(in, "best_arg");
+    ck.round_start_arg = read_vec(in, "round_start_arg");
+    ck.top_args.resize(read_value<size_t>(in, "top"));
+    for (auto& arg : ck.top_args) arg = read_vec(in, "arg");
+    ck.samplers.resize(read_value<size_t>(in, "samplers"));
+    for (sampler_state& samp : ck.samplers) {
+        samp.pop_size = read_value<size_t>(in, "pop_size");
+        samp.restarts = read_value<size_t>(in, "restarts");
+        samp.init_count = read_value<size_t>(in, "init_count");
+        samp.stall_count = read_value<size_t>(in, "stall_count");
+        samp.seed_best = read_value<bool>(in, "seed_best");
+        samp.stalled = read_value<bool>(in, "stalled");
+        expect(in, "rng");
+        if (!(in >> samp.rng)) throw std::runtime_error("invalid checkpoint: bad rng state");
+        samp.cur_lower_bounds = read_vec(in, "cur_lower_bounds");
+        samp.cur_upper_bounds = read_vec(in, "cur_upper_bounds");
+        samp.population.resize(read_value<size_t>(in, "population"));
+        for (auto& member : samp.population) member = read_vec(in, "arg");
+    }
+    return ck;
+}
+
+}
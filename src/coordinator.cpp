@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "coordinator.hpp"
+#include "server.hpp"
+
+namespace asim {
+
+#ifdef _WIN32
+
+coordinator_result run_coordinator(const coordinator_options&) {
+    throw std::runtime_error("worker processes are not supported on Windows");
+}
+
+#else
+
+struct worker_proc {
+    pid_t pid = -1;
+    // we write requests to to_fd and read replies from from_fd
+    int to_fd = -1, from_fd = -1;
+    std::string buffer;
+    size_t restarts = 0;
+    // waiting on a reply to the current epoch
+    bool busy = false;
+
+    bool alive() const {
+        return pid > 0;
+    }
+};
+
+static std::runtime_error errno_error(std::string_view what) {
+    return std::runtime_error(std::format("{} failed: {}", what, std::strerror(errno)));
+}
+
+static void spawn_worker(worker_proc& worker, const std::vector<worker_proc>& all, const coordinator_options& opts) {
+    int to_child[2], from_child[2];
+    if (pipe(to_child) != 0) throw errno_error("pipe");
+    if (pipe(from_child) != 0) {
+        close(to_child[0]);
+        close(to_child[1]);
+        throw errno_error("pipe");
+    }
+    // anything still buffered would get written twice otherwise
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        for (int fd : {to_child[0], to_child[1], from_child[0], from_child[1]}) close(fd);
+        throw errno_error("fork");
+    }
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        for (int fd : {to_child[0], to_child[1], from_child[0], from_child[1]}) close(fd);
+        // other workers' pipes would otherwise stay open for as long as we live
+        for (const worker_proc& other : all) {
+            if (other.to_fd >= 0) close(other.to_fd);
+            if (other.from_fd >= 0) close(other.from_fd);
+        }
+        if (!opts.worker_command.empty()) {
+            std::vector<char*> argv;
+            for (const std::string& arg : opts.worker_command) argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        {
+            // replies go to the pipe even if our parent silenced its own output
+            std::cout.clear();
+            server srv(opts.worker_threads, std::cout);
+            srv.serve(std::cin);
+        }
+        std::cout.flush();
+        _exit(0);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    worker.pid = pid;
+    worker.to_fd = to_child[1];
+    worker.from_fd = from_child[0];
+    worker.buffer.clear();
+    worker.busy = false;
+}
+
+// polite asks the worker to exit first, otherwise it's killed right away
+static void stop_worker(worker_proc& worker, bool polite) {
+    if (!worker.alive()) return;
+    if (polite) {
+        std::string_view line = "{\"op\":\"shutdown\"}\n";
+        [[maybe_unused]] ssize_t written = write(worker.to_fd, line.data(), line.size());
+    }
+    close(worker.to_fd);
+    close(worker.from_fd);
+    worker.to_fd = worker.from_fd = -1;
+    // without stdin the server exits once its jobs are done, which shutdown cancelled
+    time_point_t give_up = main_clock.now() + as_seconds(polite ? 2.f : 0.f);
+    while (waitpid(worker.pid, nullptr, WNOHANG) == 0) {
+        if (main_clock.now() >= give_up) {
+            kill(worker.pid, SIGKILL);
+            waitpid(worker.pid, nullptr, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    worker.pid = -1;
+    worker.busy = false;
+}
+
+static bool send_line(worker_proc& worker, const std::string& line) {
+    size_t done = 0;
+    while (done < line.size()) {
+        ssize_t written = write(worker.to_fd, line.data() + done, line.size() - done);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += written;
+    }
+    return true;
+}
+
+coordinator_result run_coordinator(const coordinator_options& opts) {
+    if (opts.workers == 0 || opts.epochs == 0) {
+        throw std::runtime_error("need at least one worker and epoch");
+    }
+    // a dead worker's pipe should show up as a failed write, not kill us
+    std::signal(SIGPIPE, SIG_IGN);
+
+    coordinator_result result;
+    std::vector<worker_proc> workers(opts.workers);
+    float epoch_seconds = opts.request.runtime / opts.epochs;
+    auto better = [&](float lhs, float rhs) { return opts.request.maximise ? lhs > rhs : lhs < rhs; };
+
+    optimise_options request = opts.request;
+    request.runtime = epoch_seconds;
+    if (request.max_evals != 0) {
+        size_t requests = opts.workers * opts.epochs;
+        request.max_evals = std::max((request.max_evals + requests - 1) / requests, (size_t)1);
+    }
+
+    auto lose_worker = [&](size_t i, std::string_view why) {
+        log([&]{ return std::format("Worker {} {}", i, why); }, opts.log_level, LOG_BASIC);
+        stop_worker(workers[i], false);
+        ++result.worker_deaths;
+    };
+
+    auto handle_reply = [&](size_t i, std::string_view line) {
+        json_object reply;
+        try {
+            reply = json_object::parse(line);
+        } catch (const std::exception& e) {
+            log([&]{ return std::format("Worker {} sent a bad reply: {}", i, e.what()); }, opts.log_level, LOG_BASIC);
+            return;
+        }
+        workers[i].busy = false;
+        if (reply.has("error")) {
+            log([&]{ return std::format("Worker {}: {}", i, reply.get_string("error")); }, opts.log_level, LOG_INFO);
+            return;
+        }
+        result.evals += reply.get_size("evals", 0);
+        float optstat = reply.get_float("optstat", NAN);
+        if (!is_finite(optstat)) return;
+        std::vector<float> arg = reply.get_floats("arg");
+        result.result_args.push_back(arg);
+        if (result.best_json.empty() || better(optstat, result.best_optstat)) {
+            result.best_json = line;
+            result.best_arg = arg;
+            result.best_optstat = optstat;
+        }
+    };
+
+    for (size_t epoch = 0; epoch < opts.epochs && !status_SIGINT; ++epoch) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (workers[i].alive()) continue;
+            if (epoch != 0 && workers[i].restarts++ >= opts.max_restarts) continue;
+            try {
+                spawn_worker(workers[i], workers, opts);
+            } catch (const std::exception& e) {
+                log([&]{ return std::format("Could not start worker {}: {}", i, e.what()); }, opts.log_level, LOG_BASIC);
+            }
+        }
+        if (std::none_of(workers.begin(), workers.end(), [](const worker_proc& w) { return w.alive(); })) {
+            throw std::runtime_error("no workers left");
+        }
+
+        std::string seed_json;
+        for (float f : result.best_arg) seed_json += (seed_json.empty() ? "" : ",") + json_number(f);
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (!workers[i].alive()) continue;
+            float lo = opts.request.mixt1, hi = opts.request.mixt2;
+            if (epoch == 0) {
+                request.mixt1 = lo + (hi - lo) * i / workers.size();
+                request.mixt2 = lo + (hi - lo) * (i + 1) / workers.size();
+            } else {
+                request.mixt1 = lo;
+                request.mixt2 = hi;
+            }
+            std::string line = std::format("{{\"op\":\"optimise\",\"id\":{},{},\"threads\":{}{}}}\n",
+                                           epoch, request.to_json_fields(), opts.worker_threads, seed_json.empty() ? "" : ",\"seed\":[" + seed_json + "]");
+            if (send_line(workers[i], line)) {
+                workers[i].busy = true;
+            } else {
+                lose_worker(i, "stopped taking requests");
+            }
+        }
+
+        time_point_t deadline = main_clock.now() + as_seconds(epoch_seconds + opts.timeout_grace);
+        while (true) {
+            std::vector<pollfd> fds;
+            std::vector<size_t> fd_workers;
+            for (size_t i = 0; i < workers.size(); ++i) {
+                if (!workers[i].busy) continue;
+                fds.push_back({workers[i].from_fd, POLLIN, 0});
+                fd_workers.push_back(i);
+            }
+            if (fds.empty()) break;
+
+            int wait_ms = std::max(0, (int)std::ceil(to_seconds(deadline - main_clock.now()) * 1000.f));
+            int ready = poll(fds.data(), fds.size(), wait_ms);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                throw errno_error("poll");
+            }
+            if (ready == 0) {
+                for (size_t i : fd_workers) lose_worker(i, "timed out");
+                break;
+            }
+            for (size_t k = 0; k < fds.size(); ++k) {
+                if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                size_t i = fd_workers[k];
+                char buf[4096];
+                ssize_t got = read(workers[i].from_fd, buf, sizeof(buf));
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) {
+                    lose_worker(i, "died");
+                    continue;
+                }
+                workers[i].buffer.append(buf, got);
+                size_t nl;
+                while ((nl = workers[i].buffer.find('\n')) != std::string::npos) {
+                    std::string line = workers[i].buffer.substr(0, nl);
+                    workers[i].buffer.erase(0, nl + 1);
+                    handle_reply(i, line);
+                }
+            }
+        }
+
+        log([&]{ return std::format("Epoch {}: {} samples, best optstat {}", epoch + 1, result.evals,
+                                    result.best_json.empty() ? "none" : std::format("{}", result.best_optstat)); }, opts.log_level, LOG_BASIC);
+    }
+
+    for (worker_proc& worker : workers) stop_worker(worker, true);
+    return result;
+}
+
+#endif
+
+}
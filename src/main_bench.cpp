@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <argparse/args.hpp>
+#include <argparse/read.hpp>
+
+#include "constants.hpp"
+#include "optimiser.hpp"
+#include "sim.hpp"
+#include "utility.hpp"
+
+using namespace std;
+using namespace asim;
+
+// canonical recipes, changing these invalidates stored baselines
+static const string maxcap_recipe = "ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]";
+static const string longfuse_recipe = "ft=123.94 fp=721 tp=1013.25 tt=535.4 mi=[[nitrous_oxide,0.73071],[tritium,0.26929003]] pm=[[oxygen,0.13285],[frezon,0.86715007]]";
+static const string frezon_recipe = "ft=522.61 fp=886.9 tp=1013.25 tt=73.18 mi=[[plasma,0.45829457],[tritium,0.5417054]] pm=[[oxygen,0.95256007],[frezon,0.047440004]]";
+
+struct bench_result {
+    string bench;
+    string metric;
+    size_t threads;
+    float value;
+
+    string key() const {
+        return format("{} {} {}", bench, metric, threads);
+    }
+    string json() const {
+        return format("{{\"bench\":{},\"metric\":{},\"threads\":{},\"value\":{}}}", json_string(bench), json_string(metric), threads, json_number(value));
+    }
+};
+
+// runs fn until at least seconds have passed, returns how many times it ran per second and the seconds taken
+template<typename F>
+static pair<float, float> time_rate(float seconds, F&& fn) {
+    size_t runs = 0;
+    time_point_t start = main_clock.now();
+    float took = 0.f;
+    do {
+        fn();
+        ++runs;
+        took = to_seconds(main_clock.now() - start);
+    } while (took < seconds);
+    return {runs / took, took};
+}
+
+int main(int argc, char* argv[]) {
+    handle_sigint();
+
+    float seconds = 1.f;
+    size_t max_threads = max(1u, thread::hardware_concurrency());
+    vector<string> only;
+    string json_path;
+    string compare_path;
+    float tolerance = 0.1f;
+
+    std::vector<std::shared_ptr<argp::base_argument>> args = {
+        argp::make_argument("seconds", "", "how long to run each workload for (default " + to_string(seconds) + ")", seconds),
+        argp::make_argument("nthreads", "j", "most threads to measure optimiser scaling with, it's measured at powers of two up to this (default: hardware threads, " + to_string(max_threads) + ")", max_threads),
+        argp::make_argument("only", "", "[name,...]: only run these workloads out of maxcap, longfuse, frezon, do_sim, tolerances and optimiser", only),
+        argp::make_argument("json", "", "write results here as JSON lines, one {\"bench\",\"metric\",\"threads\",\"value\"} object each", json_path),
+        argp::make_argument("compare", "", "compare against results earlier written with --json, and exit with 1 if anything got slower by more than --tolerance", compare_path),
+        argp::make_argument("tolerance", "", "fraction by which a result may be slower than --compare's before it counts as a regression (default " + to_string(tolerance) + ")", tolerance)
+    };
+
+    argp::parse_arguments(args, argc, argv,
+        "Atmosim benchmarks: times canonical bomb workloads, to catch performance regressions\n"
+        "  Every metric is a rate, so higher is better.\n",
+        "\n"
+        "Example usage:\n"
+        "  $ ./atmosim_bench --json=baseline.json\n"
+        "  $ ./atmosim_bench --compare=baseline.json\n"
+    );
+    max_threads = max(max_threads, (size_t)1);
+
+    auto selected = [&](string_view name) {
+        return only.empty() || find(only.begin(), only.end(), name) != only.end();
+    };
+
+    vector<bench_result> results;
+    auto report = [&](bench_result res) {
+        cout << format("{:<12} {:<20} {:>3} thread{} {:>14.1f}", res.bench, res.metric, res.threads, res.threads == 1 ? " " : "s", res.value) << endl;
+        results.push_back(std::move(res));
+    };
+
+    // whole-recipe simulation, from a fresh tank every time
+    auto bench_recipe = [&](const string& name, const string& recipe, size_t tick_cap) {
+        bomb_data fresh = bomb_data::deserialize(recipe);
+        size_t ticks = 0;
+        auto [rate, took] = time_rate(seconds, [&] {
+            bomb_data data = fresh;
+            data.sim_ticks(tick_cap, bomb_data::radius_field, false);
+            ticks += data.ticks;
+        });
+        report({name, "sims_per_s", 1, rate});
+        report({name, "ticks_per_s", 1, ticks / took});
+    };
+    if (selected("maxcap")) bench_recipe("maxcap", maxcap_recipe, 1000);
+    if (selected("longfuse")) bench_recipe("longfuse", longfuse_recipe, 1200);
+    if (selected("frezon")) bench_recipe("frezon", frezon_recipe, 1000);
+
+    // a maxcap search, as the optimiser would evaluate it
+    vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen};
+    vector<field_restriction<bomb_data>> no_restrictions;
+    bomb_args search_args{mix_gases, primer_gases, false, 0.1f, 0.01f, 0.00001f, 1000, bomb_data::radius_field, no_restrictions, no_restrictions};
+    vector<float> lower_bounds = {plasma_fire_temp + 0.1f, 375.15f, 293.15f, pressure_cap, -3.f};
+    vector<float> upper_bounds = {plasma_fire_temp + 0.1f, 595.15f, 293.15f, pressure_cap, 3.f};
+
+    if (selected("do_sim")) {
+        // fixed points, so every run evaluates the same mix of valid and invalid candidates
+        mt19937 rng(0);
+        vector<vector<float>> points(1024, vector<float>(lower_bounds.size()));
+        for (vector<float>& at : points) {
+            for (size_t d = 0; d < at.size(); ++d) at[d] = uniform_real_distribution<float>(lower_bounds[d], upper_bounds[d])(rng);
+        }
+        size_t idx = 0;
+        auto [rate, took] = time_rate(seconds, [&] {
+            do_sim(points[idx++ % points.size()], search_args);
+        });
+        report({"do_sim", "sims_per_s", 1, rate});
+    }
+
+    if (selected("tolerances")) {
+        bomb_data data = bomb_data::deserialize(maxcap_recipe);
+        data.sim_ticks(1000, bomb_data::radius_field, false);
+        thread_pool pool(1);
+        auto [rate, took] = time_rate(seconds, [&] {
+            data.tolerances(default_tol, pool);
+        });
+        report({"tolerances", "runs_per_s", 1, rate});
+    }
+
+    if (selected("optimiser")) {
+        vector<size_t> thread_counts;
+        for (size_t n = 1; n < max_threads; n *= 2) thread_counts.push_back(n);
+        thread_counts.push_back(max_threads);
+        for (size_t n : thread_counts) {
+            if (status_SIGINT) break;
+            optimiser<bomb_args, opt_val_wrap> optim(do_sim, lower_bounds, upper_bounds, true, search_args, as_seconds(seconds), 1, 0.5f, LOG_NONE);
+            optim.n_threads = n;
+            // keep going for the whole time, we're measuring throughput rather than results
+            optim.stall_generations = 0;
+            time_point_t start = main_clock.now();
+            optim.find_best();
+            report({"optimiser", "evals_per_s", n, optim.eval_count / to_seconds(main_clock.now() - start)});
+        }
+    }
+
+    if (!json_path.empty()) {
+        ofstream out(json_path);
+        if (!out) {
+            cout << "Could not open " << json_path << " for writing." << endl;
+            return 1;
+        }
+        for (const bench_result& res : results) out << res.json() << '\n';
+    }
+
+    if (compare_path.empty()) return 0;
+
+    ifstream in(compare_path);
+    if (!in) {
+        cout << "Could not open baseline " << compare_path << "." << endl;
+        return 1;
+    }
+    map<string, float> baseline;
+    string line;
+    try {
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            json_object obj = json_object::parse(line);
+            baseline[bench_result{obj.get_string("bench"), obj.get_string("metric"), obj.get_size("threads", 1), 0.f}.key()] = obj.get_float("value", 0.f);
+        }
+    } catch (const exception& e) {
+        cout << "Invalid baseline " << compare_path << ": " << e.what() << endl;
+        return 1;
+    }
+
+    cout << format("\nCompared to {}:", compare_path) << endl;
+    size_t regressions = 0;
+    for (const bench_result& res : results) {
+        auto it = baseline.find(res.key());
+        if (it == baseline.end() || it->second <= 0.f) {
+            cout << format("{:<12} {:<20} {:>3}: not in baseline", res.bench, res.metric, res.threads) << endl;
+            continue;
+        }
+        float change = res.value / it->second - 1.f;
+        bool regressed = change < -tolerance;
+        regressions += regressed;
+        cout << format("{:<12} {:<20} {:>3}: {:+.1f}%{}", res.bench, res.metric, res.threads, change * 100.f, regressed ? "  REGRESSION" : "") << endl;
+    }
+    if (regressions != 0) {
+        cout << format("{} result{} slower than the baseline by more than {:.0f}%.", regressions, regressions == 1 ? "" : "s", tolerance * 100.f) << endl;
+        return 1;
+    }
+    return 0;
+}
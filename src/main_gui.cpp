@@ -2,7 +2,9 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <algorithm>
 #include <atomic>
+#include <fstream>
 #include <sstream>
 
 #include <argparse/args.hpp>
@@ -23,7 +25,7 @@ using namespace std;
 using namespace asim;
 
 struct AtmosimState {
-    enum class WorkMode { Normal, Mixing, FullInput, Tolerances };
+    enum class WorkMode { Normal, Mixing, FullInput, Tolerances, ValidityMap };
     WorkMode current_mode = WorkMode::Normal;
 
     // --- Primary Optimizer Config ---
@@ -74,6 +76,18 @@ struct AtmosimState {
     float tol_val = 0.95f;
     std::string tol_result_log = "";
 
+    // --- Validity Map Tool Config ---
+    char map_serial_str[1024] = "";
+    char map_x_key[16] = "ft";
+    char map_y_key[16] = "tp";
+    float map_x_range[2] = { 0.0f, 0.0f }; // equal means automatic
+    float map_y_range[2] = { 0.0f, 0.0f };
+    int map_size[2] = { 256, 256 };
+    char map_csv_path[512] = "map.csv";
+    validity_map map;
+    bool has_map = false;
+    std::string map_result_log = "";
+
     AtmosimState() {
         pressure_bounds[0] = pressure_cap;
         pressure_bounds[1] = pressure_cap;
@@ -146,7 +160,7 @@ void RunOptimizationJob(AtmosimState* state) {
             oss << "Best Configuration Found:\n"
                 << optim.best_result.data->print_full() << "\n\n"
                 << "Serialized string: " << optim.best_result.data->serialize() << "\n\n"
-                << default_tol << "x Tolerances:\n" << optim.best_result.data->measure_tolerances();
+                << default_tol << "x Tolerances:\n" << optim.best_result.data->measure_tolerances(default_tol, optim.n_threads);
         } else {
             oss << "No viable recipes found within constraints.";
         }
@@ -275,13 +289,8 @@ void RenderSimulationTab(AtmosimState& state) {
                 ++tick;
             }
 
-            const char* state_name = "unknown";
-            if (tank.state == gas_tank::st_intact) state_name = "intact";
-            else if (tank.state == gas_tank::st_ruptured) state_name = "ruptured";
-            else if (tank.state == gas_tank::st_exploded) state_name = "exploded";
-
             oss << std::format("\nFinal Result:\n  Status: {}\n  State: {}\n  Radius: {:.2f}",
-                            tank.get_status(), state_name, tank.calc_radius());
+                            tank.get_status(), tank.state_name(), tank.calc_radius());
 
             state.fi_result_log = oss.str();
         } catch (const std::exception& e) {
@@ -308,7 +317,7 @@ void RenderTolerancesTab(AtmosimState& state) {
             data.fin_radius = data.tank.calc_radius();
             data.fin_pressure = data.tank.mix.pressure();
 
-            state.tol_result_log = std::format("Tolerances for Target {}:\n{}", state.tol_val, data.measure_tolerances(state.tol_val));
+            state.tol_result_log = std::format("Tolerances for Target {}:\n{}", state.tol_val, data.measure_tolerances(state.tol_val, static_cast<size_t>(state.nthreads)));
         } catch (const std::exception& e) {
             state.tol_result_log = std::string("Tolerance Error: ") + e.what();
         }
@@ -319,6 +328,118 @@ void RenderTolerancesTab(AtmosimState& state) {
                               ImVec2(-FLT_MIN, -FLT_MIN), ImGuiInputTextFlags_ReadOnly);
 }
 
+void RenderValidityMapTab(AtmosimState& state) {
+    ImGui::TextWrapped("Simulate a bomb serialised string over a grid of two of its parameters to see which combinations still work. "
+                       "Parameters are ft, fp, tt, tp, or miN/pmN for the Nth mix/primer gas. Leave a range at 0 - 0 to use twice its tolerance range.");
+    ImGui::Spacing();
+
+    ImGui::InputText("Serialized Bomb String", state.map_serial_str, IM_ARRAYSIZE(state.map_serial_str));
+    ImGui::InputText("X Parameter", state.map_x_key, IM_ARRAYSIZE(state.map_x_key));
+    ImGui::InputFloat2("X Range", state.map_x_range);
+    ImGui::InputText("Y Parameter", state.map_y_key, IM_ARRAYSIZE(state.map_y_key));
+    ImGui::InputFloat2("Y Range", state.map_y_range);
+    ImGui::InputInt2("Grid Size", state.map_size);
+    ImGui::InputFloat("Tolerance Range Target", &state.tol_val, 0.01f, 0.05f, "%.3f");
+
+    if (ImGui::Button("Compute Map", ImVec2(200, 30))) {
+        try {
+            bomb_data data = bomb_data::deserialize(state.map_serial_str);
+            data.ticks = data.tank.tick_n(state.tick_cap);
+            data.fin_radius = data.tank.calc_radius();
+            data.fin_pressure = data.tank.mix.pressure();
+
+            thread_pool pool(static_cast<size_t>(std::max(1, state.nthreads)));
+            recipe_param x_param = recipe_param::from_key(state.map_x_key);
+            recipe_param y_param = recipe_param::from_key(state.map_y_key);
+            auto get_range = [&](recipe_param param, const float* range) -> std::pair<float, float> {
+                if (range[0] != range[1]) return {range[0], range[1]};
+                return data.map_range(param, state.tol_val, pool);
+            };
+            auto [x_min, x_max] = get_range(x_param, state.map_x_range);
+            auto [y_min, y_max] = get_range(y_param, state.map_y_range);
+
+            state.map = data.map_validity(x_param, x_min, x_max, static_cast<size_t>(std::max(1, state.map_size[0])),
+                                          y_param, y_min, y_max, static_cast<size_t>(std::max(1, state.map_size[1])),
+                                          state.tol_val, pool);
+            state.has_map = true;
+            state.map_result_log = std::format("{}: {} - {}, {}: {} - {}",
+                                               x_param.name(data), x_min, x_max, y_param.name(data), y_min, y_max);
+        } catch (const std::exception& e) {
+            state.map_result_log = std::string("Map Error: ") + e.what();
+        }
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!state.has_map);
+    if (ImGui::Button("Save CSV", ImVec2(120, 30))) {
+        std::ofstream out_file(state.map_csv_path);
+        if (out_file) {
+            state.map.write_csv(out_file);
+            state.map_result_log = std::format("Saved to {}", state.map_csv_path);
+        } else {
+            state.map_result_log = std::format("Couldn't open {} for writing", state.map_csv_path);
+        }
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Load CSV", ImVec2(120, 30))) {
+        try {
+            std::ifstream in_file(state.map_csv_path);
+            if (!in_file) throw std::runtime_error(std::format("couldn't open {}", state.map_csv_path));
+            state.map = validity_map::read_csv(in_file);
+            state.has_map = true;
+            state.map_result_log = std::format("{}: {} - {}, {}: {} - {}",
+                                               state.map.x_param.key(), state.map.x_min, state.map.x_max,
+                                               state.map.y_param.key(), state.map.y_min, state.map.y_max);
+        } catch (const std::exception& e) {
+            state.map_result_log = std::string("Map Error: ") + e.what();
+        }
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    ImGui::InputText("##mapcsv", state.map_csv_path, IM_ARRAYSIZE(state.map_csv_path));
+
+    ImGui::TextUnformatted(state.map_result_log.c_str());
+    ImGui::Separator();
+    if (!state.has_map || state.map.width == 0 || state.map.height == 0) return;
+
+    // valid points are green, invalid ones red, brighter for bigger radius
+    const validity_map& map = state.map;
+    float max_radius = *std::max_element(map.radius.begin(), map.radius.end());
+    if (max_radius <= 0.f) max_radius = 1.f;
+    auto cell_colour = [&](size_t i) {
+        float shade = 0.25f + 0.75f * map.radius[i] / max_radius;
+        return map.valid[i] ? ImGui::GetColorU32(ImVec4(0.1f, shade, 0.2f, 1.0f))
+                            : ImGui::GetColorU32(ImVec4(shade, 0.1f, 0.1f, 1.0f));
+    };
+
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float cell_w = avail.x / map.width, cell_h = std::max(avail.y, 1.0f) / map.height;
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    for (size_t y = 0; y < map.height; ++y) {
+        // y grows upwards
+        float y1 = origin.y + (map.height - y) * cell_h;
+        // merge runs of the same colour to keep the vertex count down
+        for (size_t x = 0; x < map.width;) {
+            ImU32 colour = cell_colour(y * map.width + x);
+            size_t run_end = x + 1;
+            while (run_end < map.width && cell_colour(y * map.width + run_end) == colour) ++run_end;
+            draw_list->AddRectFilled(ImVec2(origin.x + x * cell_w, y1 - cell_h), ImVec2(origin.x + run_end * cell_w, y1), colour);
+            x = run_end;
+        }
+    }
+
+    ImGui::InvisibleButton("##map", ImVec2(avail.x, std::max(avail.y, 1.0f)));
+    if (ImGui::IsItemHovered()) {
+        ImVec2 mouse = ImGui::GetMousePos();
+        size_t x = std::min(map.width - 1, static_cast<size_t>(std::max(0.0f, (mouse.x - origin.x) / cell_w)));
+        size_t y = std::min(map.height - 1, static_cast<size_t>(std::max(0.0f, (origin.y + map.height * cell_h - mouse.y) / cell_h)));
+        size_t i = y * map.width + x;
+        ImGui::SetTooltip("%s = %g\n%s = %g\nradius %.2f, %d ticks\n%s", map.x_param.key().c_str(), map.x_at(x),
+                          map.y_param.key().c_str(), map.y_at(y), map.radius[i], map.ticks[i], map.valid[i] ? "valid" : "invalid");
+    }
+}
+
 void RenderAtmosimUI(AtmosimState& state) {
     const ImGuiViewport* viewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(viewport->WorkPos);
@@ -357,6 +478,12 @@ void RenderAtmosimUI(AtmosimState& state) {
             ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Validity Map")) {
+            state.current_mode = AtmosimState::WorkMode::ValidityMap;
+            RenderValidityMapTab(state);
+            ImGui::EndTabItem();
+        }
+
         ImGui::EndTabBar();
     }
 
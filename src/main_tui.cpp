@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -5,8 +8,14 @@
 #include <argparse/args.hpp>
 #include <argparse/read.hpp>
 
+#include "batch.hpp"
 #include "constants.hpp"
+#include "coordinator.hpp"
+#include "optimise.hpp"
 #include "optimiser.hpp"
+#include "pareto.hpp"
+#include "server.hpp"
+#include "sweep.hpp"
 #include "gas.hpp"
 #include "sim.hpp"
 #include "utility.hpp"
@@ -56,7 +65,7 @@ int main(int argc, char* argv[]) {
 
     size_t log_level = 2;
 
-    enum struct work_mode {normal, mixing, full_input, tolerances};
+    enum struct work_mode {normal, mixing, full_input, tolerances, robustness, validity_map, batch, server};
     work_mode mode = work_mode::normal;
 
     bool mixing_mode = false, full_input_mode = false, tolerances_mode = false;
@@ -70,6 +79,7 @@ int main(int argc, char* argv[]) {
     float lower_target_temp = plasma_fire_temp + 0.1f;
     float lower_pressure = pressure_cap, upper_pressure = pressure_cap;
     bool step_target_temp = false;
+    bool solve_target_temp = false;
     size_t tick_cap = numeric_limits<size_t>::max(); // 10 minutes
     float round_temp_to = 0.01f, round_pressure_to = 0.1f, round_ratio_to = 0.001f; // default is 0.001% to mitigate FP inaccuracy
                                                            // note: this is percentage
@@ -82,14 +92,67 @@ int main(int argc, char* argv[]) {
     size_t sample_rounds = 5;
     float bounds_scale = 0.5f;
     size_t nthreads = 1;
+    size_t max_evals = 0;
+    size_t stall_gens = 0;
+    float stall_eps = 0.f;
+    bool restarts = false;
+    string init_mode = "uniform";
+    string seed_path;
+    bool grid_mode = false;
+    vector<tuple<field_ref<bomb_data>, bool>> pareto_objectives;
+    float sweep_seconds = 0.f;
+    vector<gas_ref> sweep_gases_list;
+    tuple<size_t, size_t> sweep_sizes{2, 2};
+    size_t top_k = 5;
+    float top_dist = 0.01f;
+    string json_out_path;
+    size_t n_workers = 0;
+    vector<string> worker_command;
+    size_t epochs = 4;
+    string checkpoint_path;
+    float checkpoint_every = 60.f;
+    bool resume = false;
+    size_t grid_max = 100000000;
+    float restart_growth = 2.f;
+    size_t surrogate_size = 0;
+    size_t surrogate_k = 5;
+    float surrogate_explore = 0.1f;
+    size_t sensitivity_trajectories = 0;
+    float freeze_threshold = 0.05f;
+    tuple<float, float, float> robust_deltas{0.f, 0.f, 0.f};
+    float robust_quantile = 0.f;
+    vector<size_t> screen_horizons;
+    float screen_keep = 1.f / 3.f;
+    size_t robustness_samples = 0;
+    mismix_dist mismix;
+    tuple<float, float, float> mismix_widths{mismix.temp_width, mismix.pressure_width, mismix.ratio_width * 100.f};
+    vector<string> map_params;
+    tuple<size_t, size_t> map_size{256, 256};
+    tuple<float, float> map_x_range{0.f, 0.f}, map_y_range{0.f, 0.f};
+    string map_out = "map.csv";
+    string batch_path;
+    bool batch_tolerances = false;
+    bool server_mode = false;
 
     std::vector<std::shared_ptr<argp::base_argument>> args = {
         argp::make_argument("ratiob", "", "set gas ratio iteration bound", ratio_bound),
         argp::make_argument("ratiobounds", "rbs", "set gas ratio iteration bounds: exact setup", ratio_bounds),
         argp::make_argument("mixtoiter", "s", "provide potentially better results by also iterating the mix-to temperature (WARNING: will take many times longer to calculate)", step_target_temp),
+        argp::make_argument("mixtosolve", "", "instead of searching over the mix-to temperature like --mixtoiter, find the best one for every candidate with a golden-section search on the --roundtemp grid; much faster than --mixtoiter if the result has a single peak in mix-to temperature, overrides it", solve_target_temp),
         argp::make_argument("mixingmode", "m", "UTILITY TOOL: utility to find desired mixer percentage if mixing different-temperature gases", mixing_mode),
         argp::make_argument("fullinput", "f", "UTILITY TOOL: simulate and print every tick of a bomb with chosen gases", full_input_mode),
         argp::make_argument("tolerance", "", "UTILITY TOOL: measure tolerances for a bomb serialised string", tolerances_mode),
+        argp::make_argument("robustness", "", "UTILITY TOOL: estimate how often a bomb serialised string still works when mismixed, from this many random samples", robustness_samples),
+        argp::make_argument("mismix", "", "(temp, pressure, ratio): how far --robustness perturbs temperatures, pressures and gas percentages (default: [" + to_string(get<0>(mismix_widths)) + ", " + to_string(get<1>(mismix_widths)) + ", " + to_string(get<2>(mismix_widths)) + "])", mismix_widths),
+        argp::make_argument("mismixuniform", "", "draw --robustness perturbations uniformly within the --mismix widths instead of using them as standard deviations", mismix.uniform),
+        argp::make_argument("map", "", "UTILITY TOOL: [x, y]: simulate a bomb serialised string over a grid of two of its parameters (ft, fp, tt, tp, miN or pmN for the Nth gas) and write which combinations still work to --mapout", map_params),
+        argp::make_argument("mapsize", "", "(width, height): grid size for --map (default: [" + to_string(get<0>(map_size)) + ", " + to_string(get<1>(map_size)) + "])", map_size),
+        argp::make_argument("mapx", "", "(min, max): x range for --map, gas ratios as fractions of their mix, default is twice the tolerance range", map_x_range),
+        argp::make_argument("mapy", "", "(min, max): y range for --map, gas ratios as fractions of their mix, default is twice the tolerance range", map_y_range),
+        argp::make_argument("mapout", "", "CSV file for --map to write to, can be viewed in the GUI (default: " + map_out + ")", map_out),
+        argp::make_argument("batch", "", "UTILITY TOOL: simulate every bomb serialised string in this file, one per line, or - for stdin; writes a JSON line of results for each", batch_path),
+        argp::make_argument("batchtol", "", "also measure tolerances in --batch mode", batch_tolerances),
+        argp::make_argument("server", "", "UTILITY TOOL: keep running and serve simulate, tolerance and optimise requests as JSON lines over stdin/stdout, see include/server.hpp", server_mode),
         argp::make_argument("mixg", "mg", "list of fuel gases (usually, in tank)", mix_gases),
         argp::make_argument("primerg", "pg", "list of primer gases (usually, in canister)", primer_gases),
         argp::make_argument("mixt1", "m1", "minimum fuel mix temperature to check, Kelvin", mixt1),
@@ -112,7 +175,38 @@ int main(int argc, char* argv[]) {
         argp::make_argument("runtime", "rt", "for how long to run in seconds (default " + to_string(max_runtime) + ")", max_runtime),
         argp::make_argument("samplerounds", "sr", "how many sampling rounds to perform, multiplies runtime (default " + to_string(sample_rounds) + ")", sample_rounds),
         argp::make_argument("boundsscale", "", "how much to scale bounds each sample round (default " + to_string(bounds_scale) + ")", bounds_scale),
-        argp::make_argument("nthreads", "j", "number of threads for the optimiser to use", nthreads)
+        argp::make_argument("nthreads", "j", "number of threads for the optimiser and tolerance measurement to use", nthreads),
+        argp::make_argument("maxevals", "me", "stop after this many simulations in total, 0 for no limit (default " + to_string(max_evals) + ")", max_evals),
+        argp::make_argument("stallgens", "", "end a sampling round early if the best result hasn't improved for this many generations, and stop entirely if a whole round didn't improve; 0 to disable (default " + to_string(stall_gens) + ")", stall_gens),
+        argp::make_argument("stalleps", "", "minimum optstat improvement which counts as progress for --stallgens (default " + to_string(stall_eps) + ")", stall_eps),
+        argp::make_argument("restarts", "", "instead of stalling, restart the search over the full bounds with a bigger population to look for other recipes", restarts),
+        argp::make_argument("restartgrowth", "", "how much to grow the population on each restart (default " + to_string(restart_growth) + ")", restart_growth),
+        argp::make_argument("surrogate", "", "remember this many recent simulations per thread and skip simulating candidates whose nearest remembered neighbours say they'd be discarded; saves time when simulations are slow, 0 to disable (default " + to_string(surrogate_size) + ")", surrogate_size),
+        argp::make_argument("surrogatek", "", "how many nearest neighbours --surrogate asks (default " + to_string(surrogate_k) + ")", surrogate_k),
+        argp::make_argument("surrogateexplore", "", "fraction of candidates --surrogate would skip that get simulated anyway, to check its predictions (default " + to_string(surrogate_explore) + ")", surrogate_explore),
+        argp::make_argument("sensitivity", "", "before optimising, measure how much each parameter matters with this many random one-at-a-time trajectories (Morris method), and stop varying ones that barely do; 0 to disable (default " + to_string(sensitivity_trajectories) + ")", sensitivity_trajectories),
+        argp::make_argument("freezebelow", "", "--sensitivity stops varying parameters whose mean effect is below this fraction of the biggest one's (default " + to_string(freeze_threshold) + ")", freeze_threshold),
+        argp::make_argument("pareto", "", "[[param,maximise],...]: instead of optimising --param alone, find the recipes no other recipe beats in all of these at once, e.g. the biggest bomb for every fuse time with [[radius,true],[ticks,false]]", pareto_objectives),
+        argp::make_argument("sweep", "", "instead of optimising -mg and -pg, spend this many seconds in total trying every combination of fuel and primer gases; combinations get a short optimisation each, then the worse half is dropped and the rest run for twice as long, until one is left", sweep_seconds),
+        argp::make_argument("sweepgases", "", "gases for --sweep to pick from (default: all)", sweep_gases_list),
+        argp::make_argument("sweepsize", "", "(fuel, primer): most gases --sweep puts in the fuel and primer mixes (default: [" + to_string(get<0>(sweep_sizes)) + ", " + to_string(get<1>(sweep_sizes)) + "])", sweep_sizes),
+        argp::make_argument("grid", "", "instead of optimising, check every combination of parameters at the rounding resolution (see --roundtemp etc.); guarantees the best result, but only feasible for few gases or coarse rounding", grid_mode),
+        argp::make_argument("topk", "", "how many of the best results to keep and print, 0 for only the best; with --workers, out of the best each worker found in each epoch (default " + to_string(top_k) + ")", top_k),
+        argp::make_argument("topdist", "", "results within this fraction of the search bounds of a better one in every parameter are left out of --topk (default " + to_string(top_dist) + ")", top_dist),
+        argp::make_argument("jsonout", "", "file to write --topk results to as JSON lines, as soon as they are found", json_out_path),
+        argp::make_argument("workers", "", "run the optimiser in this many worker processes with -j threads each, exchanging their best result every --epochs; 0 to optimise in this process; not for --grid, --pareto, --seedfrom or --checkpoint (default " + to_string(n_workers) + ")", n_workers),
+        argp::make_argument("workercmd", "", "[command,args...]: run this instead of forking for each worker, it has to serve --server requests over stdin/stdout, e.g. [./atmosim,--server,-j=2]", worker_command),
+        argp::make_argument("epochs", "", "how many parts --workers splits --runtime into, exchanging best results in between (default " + to_string(epochs) + ")", epochs),
+        argp::make_argument("checkpoint", "", "file to save the optimiser's progress to every --checkpointevery seconds and when stopped, e.g. by Ctrl+C", checkpoint_path),
+        argp::make_argument("checkpointevery", "", "seconds between --checkpoint saves (default " + to_string(checkpoint_every) + ")", checkpoint_every),
+        argp::make_argument("resume", "", "carry on from the --checkpoint file instead of starting over; give the same options as the run that saved it, --runtime counts from its start", resume),
+        argp::make_argument("gridmax", "", "refuse to --grid scan more than this many points (default " + to_string(grid_max) + ")", grid_max),
+        argp::make_argument("seedfrom", "", "file of known good recipes to start from, or - for stdin: bomb serialised strings or JSON lines with a \"recipe\", like --jsonout writes; they don't need to use the same gases, but gases a recipe lacks start at the smallest share --ratiob or --ratiobounds allows", seed_path),
+        argp::make_argument("init", "", "how to draw initial populations: uniform, sobol or lhs (latin hypercube); the latter two cover the search space more evenly (default " + init_mode + ")", init_mode),
+        argp::make_argument("robust", "", "(temp, pressure, ratio): rate bombs by their worst outcome when any one of their temperatures, pressures or gas percentages is off by this much, to find recipes tolerant to mismixing", robust_deltas),
+        argp::make_argument("robustquantile", "", "with --robust, rate by this quantile of the mismixed outcomes instead of the worst one, 0 to 1 (default " + to_string(robust_quantile) + ")", robust_quantile),
+        argp::make_argument("screen", "", "[ticks,...]: for long --ticks caps, stop simulating candidates at each of these tick counts unless their extrapolated pressure is among the best --screenkeep of candidates there; e.g. [cap/27,cap/9,cap/3]; not used by --pareto", screen_horizons),
+        argp::make_argument("screenkeep", "", "fraction of candidates --screen lets through at each stage (default " + to_string(screen_keep) + ")", screen_keep)
     };
 
     argp::parse_arguments(args, argc, argv,
@@ -143,6 +237,8 @@ int main(int argc, char* argv[]) {
         "  Additionally, consider letting the optimiser think for longer using the -rt and -sr flags.\n"
         "  If you want a long-fuse bomb, try using the -p flag to optimise to maximise ticks and the -ra flag to restrict radius to be above a desired value.\n"
         "  Remember to use the -t flag to raise maximum alotted ticks if you're trying to find long-fuse bombs.\n"
+        "  For reproducible run lengths independent of machine load, use --maxevals, optionally with a large -rt.\n"
+        "  Use --stallgens to stop early once the search has converged.\n"
         "\n"
         "  Brought to you by Ilya246 and friends"
     );
@@ -151,6 +247,10 @@ int main(int argc, char* argv[]) {
     if (mixing_mode) mode = work_mode::mixing;
     if (full_input_mode) mode = work_mode::full_input;
     if (tolerances_mode) mode = work_mode::tolerances;
+    if (robustness_samples != 0) mode = work_mode::robustness;
+    if (!map_params.empty()) mode = work_mode::validity_map;
+    if (!batch_path.empty()) mode = work_mode::batch;
+    if (server_mode) mode = work_mode::server;
 
     switch (mode) {
         case (work_mode::mixing): {
@@ -217,14 +317,8 @@ int main(int argc, char* argv[]) {
                 ++tick;
             }
 
-            const char* state_name = "unknown";
-            switch (tank.state) {
-                case gas_tank::st_intact: state_name = "intact"; break;
-                case gas_tank::st_ruptured: state_name = "ruptured"; break;
-                case gas_tank::st_exploded: state_name = "exploded"; break;
-            }
             cout << format("Result:\n  Status: {}\n  State: {}\n  Radius: {:.2f}",
-                            tank.get_status(), state_name, tank.calc_radius()) << endl;
+                            tank.get_status(), tank.state_name(), tank.calc_radius()) << endl;
             break;
         }
         case (work_mode::tolerances): {
@@ -232,12 +326,93 @@ int main(int argc, char* argv[]) {
             std::string str;
             getline(cin, str);
             bomb_data data = bomb_data::deserialize(str);
+            // tolerances are measured down to the rounding precision
+            data.round_temp_to = round_temp_to;
+            data.round_pressure_to = round_pressure_to;
+            data.round_ratio_to = round_ratio_to * 0.01f;
             data.ticks = data.tank.tick_n(tick_cap);
             data.fin_radius = data.tank.calc_radius();
             data.fin_pressure = data.tank.mix.pressure();
             cout << "Input desired tolerance (omit for 0.95): ";
             float tol = input_or_default<float>(0.95f);
-            cout << "Tolerances:\n" << data.measure_tolerances(tol) << endl;
+            cout << "Tolerances:\n" << data.measure_tolerances(tol, nthreads) << endl;
+            break;
+        }
+        case (work_mode::robustness): {
+            cout << "Input serialised string: ";
+            std::string str;
+            getline(cin, str);
+            bomb_data data = bomb_data::deserialize(str);
+            data.ticks = data.tank.tick_n(tick_cap);
+            data.fin_radius = data.tank.calc_radius();
+            data.fin_pressure = data.tank.mix.pressure();
+            mismix.temp_width = get<0>(mismix_widths);
+            mismix.pressure_width = get<1>(mismix_widths);
+            mismix.ratio_width = get<2>(mismix_widths) * 0.01f;
+            cout << default_tol << "x robustness:\n" << data.measure_robustness(robustness_samples, mismix, default_tol, nthreads) << endl;
+            break;
+        }
+        case (work_mode::batch): {
+            batch_options opts;
+            opts.tick_cap = tick_cap;
+            opts.tolerances = batch_tolerances;
+            opts.round_temp_to = round_temp_to;
+            opts.round_pressure_to = round_pressure_to;
+            opts.round_ratio_to = round_ratio_to * 0.01f;
+            thread_pool pool(nthreads);
+            if (batch_path == "-") {
+                run_batch(cin, cout, opts, pool);
+                break;
+            }
+            ifstream in_file(batch_path);
+            if (!in_file) {
+                cout << "Couldn't open " << batch_path << " for reading." << endl;
+                return 1;
+            }
+            run_batch(in_file, cout, opts, pool);
+            break;
+        }
+        case (work_mode::server): {
+            server srv(nthreads, cout);
+            srv.serve(cin);
+            break;
+        }
+        case (work_mode::validity_map): {
+            if (map_params.size() != 2) {
+                cout << "--map takes exactly two parameters." << endl;
+                return 1;
+            }
+            cout << "Input serialised string: ";
+            std::string str;
+            getline(cin, str);
+            bomb_data data = bomb_data::deserialize(str);
+            data.ticks = data.tank.tick_n(tick_cap);
+            data.fin_radius = data.tank.calc_radius();
+            data.fin_pressure = data.tank.mix.pressure();
+
+            thread_pool pool(nthreads);
+            recipe_param x_param = recipe_param::from_key(map_params[0]), y_param = recipe_param::from_key(map_params[1]);
+            auto get_range = [&](recipe_param param, tuple<float, float> range) -> pair<float, float> {
+                if (get<0>(range) != get<1>(range)) return {get<0>(range), get<1>(range)};
+                return data.map_range(param, default_tol, pool);
+            };
+            auto [x_min, x_max] = get_range(x_param, map_x_range);
+            auto [y_min, y_max] = get_range(y_param, map_y_range);
+
+            auto start = chrono::high_resolution_clock::now();
+            validity_map map = data.map_validity(x_param, x_min, x_max, get<0>(map_size), y_param, y_min, y_max, get<1>(map_size), default_tol, pool);
+            float took = chrono::duration<float>(chrono::high_resolution_clock::now() - start).count();
+
+            ofstream out_file(map_out);
+            if (!out_file) {
+                cout << "Couldn't open " << map_out << " for writing." << endl;
+                return 1;
+            }
+            map.write_csv(out_file);
+            size_t n_valid = std::count(map.valid.begin(), map.valid.end(), (char)true);
+            cout << format("Mapped {} x {} ({}: {} - {}, {}: {} - {}) in {:.2f}s, {:.1f}% within {}x tolerance, written to {}",
+                           map.width, map.height, x_param.name(data), x_min, x_max, y_param.name(data), y_min, y_max,
+                           took, 100.f * n_valid / map.valid.size(), default_tol, map_out) << endl;
             break;
         }
         default: {
@@ -256,6 +431,119 @@ int main(int argc, char* argv[]) {
         cout.setstate(ios::failbit);
     }
 
+    optimise_options opts;
+    opts.mix_gases = mix_gases;
+    opts.primer_gases = primer_gases;
+    opts.mixt1 = mixt1;
+    opts.mixt2 = mixt2;
+    opts.thirt1 = thirt1;
+    opts.thirt2 = thirt2;
+    opts.lower_pressure = lower_pressure;
+    opts.upper_pressure = upper_pressure;
+    opts.lower_target_temp = lower_target_temp;
+    opts.mix_to_iter = step_target_temp;
+    opts.mix_to_solve = solve_target_temp;
+    opts.ratio_bound = ratio_bound;
+    opts.ratio_lower = get<0>(ratio_bounds);
+    opts.ratio_upper = get<1>(ratio_bounds);
+    opts.tick_cap = tick_cap;
+    opts.round_temp_to = round_temp_to;
+    opts.round_pressure_to = round_pressure_to;
+    opts.round_ratio_to = round_ratio_to;
+    opts.opt_param = opt_param;
+    opts.maximise = optimise_maximise;
+    opts.measure_before = optimise_measure_before;
+    opts.pre_restrictions = pre_restrictions;
+    opts.post_restrictions = post_restrictions;
+    opts.robust_temp = get<0>(robust_deltas);
+    opts.robust_pressure = get<1>(robust_deltas);
+    opts.robust_ratio = get<2>(robust_deltas);
+    opts.robust_quantile = robust_quantile;
+    opts.screen_horizons = screen_horizons;
+    opts.screen_keep = screen_keep;
+    opts.init_mode = init_mode;
+    opts.runtime = max_runtime;
+    opts.rounds = sample_rounds;
+    opts.bounds_scale = bounds_scale;
+    opts.max_evals = max_evals;
+    opts.stall_gens = stall_gens;
+    opts.stall_eps = stall_eps;
+    opts.restarts = restarts;
+    opts.restart_growth = restart_growth;
+    opts.surrogate_size = surrogate_size;
+    opts.surrogate_k = surrogate_k;
+    opts.surrogate_explore = surrogate_explore;
+    opts.sensitivity_trajectories = sensitivity_trajectories;
+    opts.freeze_threshold = freeze_threshold;
+
+    if (sweep_seconds > 0.f) {
+        sweep_options sweep;
+        sweep.gases = sweep_gases_list;
+        if (sweep.gases.empty()) {
+            for (size_t i = 0; i < gas_count; ++i) sweep.gases.push_back({i});
+        }
+        sweep.max_mix_gases = get<0>(sweep_sizes);
+        sweep.max_primer_gases = get<1>(sweep_sizes);
+        // combinations add their own ratio bounds
+        auto [lower_bounds, upper_bounds] = opts.bounds();
+        sweep.lower_bounds.assign(lower_bounds.begin(), lower_bounds.begin() + 4);
+        sweep.upper_bounds.assign(upper_bounds.begin(), upper_bounds.begin() + 4);
+        sweep.ratio_bound = ratio_bound;
+        sweep.maximise = optimise_maximise;
+        sweep.measure_before = optimise_measure_before;
+        sweep.round_pressure_to = round_pressure_to;
+        sweep.round_temp_to = round_temp_to;
+        sweep.round_ratio_to = round_ratio_to * 0.01f;
+        sweep.tick_cap = tick_cap;
+        sweep.opt_param = opt_param;
+        sweep.pre_restrictions = pre_restrictions;
+        sweep.post_restrictions = post_restrictions;
+        sweep.total_seconds = sweep_seconds;
+        sweep.sample_rounds = sample_rounds;
+        sweep.bounds_scale = bounds_scale;
+        sweep.log_level = log_level;
+        thread_pool pool(std::max(nthreads, (size_t)1));
+        vector<sweep_result> results;
+        try {
+            results = sweep_gases(sweep, pool);
+        } catch (const std::exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+
+        auto gas_names = [](const vector<gas_ref>& gases) {
+            string out;
+            for (gas_ref gas : gases) out += (out.empty() ? "" : ",") + string(gas.name());
+            return out;
+        };
+        cout.clear();
+        size_t shown = std::min(std::max(top_k, (size_t)1), results.size());
+        if (simple_output) {
+            for (size_t i = 0; i < shown; ++i) {
+                if (results[i].best.valid()) cout << results[i].best.data->serialize() << endl;
+            }
+        } else {
+            cout << format("\nBest {} of {} combinations:", shown, results.size()) << endl;
+            for (size_t i = 0; i < shown; ++i) {
+                const sweep_result& res = results[i];
+                cout << format("{}. [{}] + [{}], {} rungs, {:.1f}s: {}", i + 1, gas_names(res.mix_gases), gas_names(res.primer_gases), res.rungs, res.seconds,
+                               res.best.valid() ? res.best.rating_str() + ": " + res.best.data->serialize() : "nothing viable") << endl;
+            }
+        }
+        if (!json_out_path.empty()) {
+            ofstream json_out(json_out_path);
+            if (!json_out) {
+                cout << "Could not open " << json_out_path << " for writing." << endl;
+                return 1;
+            }
+            for (size_t i = 0; i < results.size(); ++i) {
+                if (!results[i].best.valid()) continue;
+                json_out << results[i].best.data->to_json(format("\"rank\":{},\"rungs\":{}", i, results[i].rungs)) << endl;
+            }
+        }
+        return 0;
+    }
+
     if ((mix_gases.empty() || primer_gases.empty()) && !silent) {
         cout << "No mix or primer gases found, see `./atmosim -h` for usage\n";
         cout << "Gases: " << list_gases() << endl;
@@ -264,55 +552,248 @@ int main(int argc, char* argv[]) {
 
     size_t num_mix_ratios = mix_gases.size() > 1 ? mix_gases.size() - 1 : 0;
     size_t num_primer_ratios = primer_gases.size() > 1 ? primer_gases.size() - 1 : 0;
-    size_t num_ratios = num_mix_ratios + num_primer_ratios;
 
-    vector<float> lower_bounds = {std::min(mixt1, thirt1), mixt1, thirt1, lower_pressure};
-    lower_bounds[0] = std::max(lower_target_temp, lower_bounds[0]);
-    vector<float> upper_bounds = {std::max(mixt2, thirt2), mixt2, thirt2, upper_pressure};
-    if (!step_target_temp) {
-        upper_bounds[0] = lower_bounds[0];
+    // these need the whole search in one process
+    if (n_workers > 0 && (grid_mode || !pareto_objectives.empty() || !seed_path.empty() || !checkpoint_path.empty() || resume)) {
+        cout << "--grid, --pareto, --seedfrom, --checkpoint and --resume can't be used with --workers." << endl;
+        return 1;
+    }
+    try {
+        opts.validate();
+    } catch (const std::exception& e) {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    optimise_run run(opts, log_level);
+    using optimiser_t = optimise_run::optimiser_t;
+    optimiser_t& optim = run.optim;
+    const vector<float>& lower_bounds = optim.lower_bounds;
+    const vector<float>& upper_bounds = optim.upper_bounds;
+    optim.n_threads = nthreads;
+    optim.top_count = top_k;
+    optim.top_distance = top_dist;
+
+    if (!seed_path.empty()) {
+        ifstream seed_file;
+        if (seed_path != "-") {
+            seed_file.open(seed_path);
+            if (!seed_file) {
+                cout << "Could not open " << seed_path << " for reading." << endl;
+                return 1;
+            }
+        }
+        istream& seed_in = seed_path == "-" ? cin : seed_file;
+        string line;
+        for (size_t line_n = 1; getline(seed_in, line); ++line_n) {
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+            try {
+                string recipe = line.front() == '{' ? json_object::parse(line).get_string("recipe") : line;
+                optim.seeds.push_back(recipe_args(bomb_data::deserialize(recipe), mix_gases, primer_gases));
+            } catch (const std::exception& e) {
+                cout << format("Could not read seed on line {}: {}", line_n, e.what()) << endl;
+                return 1;
+            }
+            // the optimiser moves these to the nearest bound, most often gases the recipe lacks, which start at the least the bounds allow
+            const vector<float>& seed = optim.seeds.back();
+            size_t outside = 0;
+            for (size_t d = 0; d < seed.size(); ++d) outside += seed[d] < lower_bounds[d] || seed[d] > upper_bounds[d];
+            if (outside != 0) {
+                log([&]{ return format("Seed on line {} is outside the search bounds in {} parameters, starting from the nearest point inside them", line_n, outside); }, log_level, LOG_BASIC);
+            }
+        }
+        log([&]{ return format("Read {} seeds", optim.seeds.size()); }, log_level, LOG_BASIC);
     }
 
-    vector<float> ratio_b_low = get<0>(ratio_bounds);
-    vector<float> ratio_b_high = get<1>(ratio_bounds);
-    if (!ratio_b_low.empty() || !ratio_b_high.empty()) {
-        if (ratio_b_low.size() != ratio_b_high.size() || ratio_b_low.size() != num_ratios) {
-            cout << "Invalid number of custom ratio bounds provided. Provide ratio bounds for the last count - 1 gases in each mix." << endl;
+    optim.checkpoint_path = checkpoint_path;
+    optim.checkpoint_spacing = as_seconds(checkpoint_every);
+    {
+        // everything that changes what do_sim rates or how the search goes; bounds, --ratiobounds included, are checked by resume() itself
+        string key = format("param {} {} {} ticks {} round {} {} {} robust {} {} {} {} mixtosolve {} screen {} {} surrogate {} {} {} sensitivity {} {}",
+                            field_name(opt_param), optimise_maximise, optimise_measure_before, tick_cap, round_temp_to, round_pressure_to, round_ratio_to,
+                            run.robust.temp_delta, run.robust.pressure_delta, run.robust.ratio_delta, run.robust.quantile, solve_target_temp,
+                            vec_to_str(run.screen.horizons, ","), run.screen.keep_fraction, surrogate_size, surrogate_k, surrogate_explore,
+                            sensitivity_trajectories, freeze_threshold);
+        for (gas_ref gas : mix_gases) key += format(" mix {}", gas.name());
+        for (gas_ref gas : primer_gases) key += format(" primer {}", gas.name());
+        for (const auto& re : pre_restrictions) key += format(" pre {} {} {}", field_name(re.field), re.min_v, re.max_v);
+        for (const auto& re : post_restrictions) key += format(" post {} {} {}", field_name(re.field), re.min_v, re.max_v);
+        optim.checkpoint_key = key;
+    }
+    if (resume) {
+        if (checkpoint_path.empty()) {
+            cout << "--resume needs a --checkpoint file to resume from." << endl;
             return 1;
         }
-        for (size_t i = 0; i < num_ratios; ++i) {
-            lower_bounds.push_back(ratio_b_low[i]);
-            upper_bounds.push_back(ratio_b_high[i]);
+        try {
+            optim.resume(checkpoint_path);
+        } catch (const std::exception& e) {
+            cout << "Could not resume: " << e.what() << endl;
+            return 1;
         }
-    } else {
-        for (size_t i = 0; i < num_ratios; ++i) {
-            lower_bounds.push_back(-ratio_bound);
-            upper_bounds.push_back(ratio_bound);
+    }
+    ofstream json_out;
+    time_point_t start_time = main_clock.now();
+    auto write_json = [&](const opt_val_wrap& res, size_t rank) {
+        json_out << res.data->to_json(format("\"rank\":{},\"evals\":{},\"time\":{:.3f}", rank, optim.eval_count.load(), to_seconds(main_clock.now() - start_time))) << endl;
+    };
+    if (!json_out_path.empty()) {
+        json_out.open(json_out_path);
+        if (!json_out) {
+            cout << "Could not open " << json_out_path << " for writing." << endl;
+            return 1;
         }
+        optim.on_top_result = [&](const vector<float>&, const opt_val_wrap& res, size_t rank) { write_json(res, rank); };
     }
 
-    optimiser<bomb_args, opt_val_wrap>
-    optim(do_sim,
-          lower_bounds,
-          upper_bounds,
-          optimise_maximise,                                                                   // convert percentage to fraction
-          {mix_gases, primer_gases, optimise_measure_before, round_pressure_to, round_temp_to, round_ratio_to * 0.01f, tick_cap, opt_param, pre_restrictions, post_restrictions},
-          as_seconds(max_runtime),
-          sample_rounds,
-          bounds_scale,
-          log_level);
-    optim.n_threads = nthreads;
+    if (!pareto_objectives.empty()) {
+        auto get_objectives = [&](const opt_val_wrap& res) {
+            vector<float> obj;
+            for (const auto& [field, maximise] : pareto_objectives) {
+                obj.push_back(maximise ? field.get(*res.data) : -field.get(*res.data));
+            }
+            return obj;
+        };
+        // robustness rates by --param alone and screening by pressure, either could drop parts of the front, so neither applies here
+        bomb_args pareto_args = optim.args;
+        pareto_args.robust = nullptr;
+        pareto_args.screen = nullptr;
+        pareto_optimiser<bomb_args, opt_val_wrap> pareto(do_sim, get_objectives, lower_bounds, upper_bounds, pareto_args, as_seconds(max_runtime), log_level);
+        pareto.n_threads = nthreads;
+        pareto.max_evals = max_evals;
+        pareto.find_front();
 
-    optim.find_best();
+        cout.clear();
+        if (pareto.front.empty()) {
+            cout << "No viable recipes found." << endl;
+        } else if (simple_output) {
+            for (const auto& p : pareto.front) cout << p.result.data->print_very_simple() << endl;
+        } else {
+            cout << format("\nPareto front of {}:", pareto.front.size()) << endl;
+            for (size_t i = 0; i < pareto.front.size(); ++i) {
+                const opt_val_wrap& res = pareto.front[i].result;
+                cout << format("{}. {}: {}", i + 1, res.rating_str(), res.data->serialize()) << endl;
+            }
+        }
+        if (json_out.is_open()) {
+            for (size_t i = 0; i < pareto.front.size(); ++i) {
+                json_out << pareto.front[i].result.data->to_json(format("\"rank\":{},\"evals\":{}", i, pareto.eval_count)) << endl;
+            }
+        }
+        return 0;
+    }
+
+    bool grid_partial = false;
+    if (grid_mode) {
+        // lattice matching what do_sim rounds to, ratios are enumerated as the rounded fractions themselves
+        // since even steps in log-ratio would round to the same fractions many times over
+        vector<float> steps = {round_temp_to, round_temp_to, round_temp_to, round_pressure_to};
+        steps.resize(lower_bounds.size(), 0.f);
+        vector<optimiser_t::grid_axis> axes = optim.grid_axes(steps);
+        axes.resize(4);
+        for (auto [first, count] : {pair{(size_t)4, num_mix_ratios}, pair{4 + num_mix_ratios, num_primer_ratios}}) {
+            if (count == 0) continue;
+            if (round_ratio_to <= 0.f) {
+                cout << "--grid needs --roundratio above 0." << endl;
+                return 1;
+            }
+            vector<float> lower(lower_bounds.begin() + first, lower_bounds.begin() + first + count);
+            vector<float> upper(upper_bounds.begin() + first, upper_bounds.begin() + first + count);
+            axes.push_back({first, ratio_lattice(lower, upper, round_ratio_to * 0.01f, grid_max)});
+        }
+        size_t grid_points = optimiser_t::grid_size(axes);
+        if (grid_points == 0 || grid_points > grid_max) {
+            cout << format("Grid of {} points is too large (--gridmax={}), use coarser rounding or narrower bounds.",
+                           grid_points == 0 ? "overflowing" : to_string(grid_points), grid_max) << endl;
+            return 1;
+        }
+        grid_partial = !optim.grid_search(axes, std::max(top_k, (size_t)1));
+        // the grid's results only come in at the end
+        if (json_out.is_open()) {
+            for (size_t i = 0; i < optim.top_results.size(); ++i) {
+                write_json(optim.top_results[i].second, i);
+            }
+        }
+    } else if (n_workers > 0) {
+        // workers get the same options through the --server optimise request, see server.hpp
+        coordinator_options coord;
+        coord.workers = n_workers;
+        coord.worker_threads = std::max(nthreads, (size_t)1);
+        coord.worker_command = worker_command;
+        coord.request = opts;
+        coord.epochs = std::max(epochs, (size_t)1);
+        coord.log_level = log_level;
+        coordinator_result res;
+        try {
+            res = run_coordinator(coord);
+        } catch (const std::exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        log([&]{ return format("{} samples from {} workers, {} died", res.evals, n_workers, res.worker_deaths); }, log_level, LOG_BASIC);
+
+        // the workers only send back their args, so rate them again here to rank and print them like our own results
+        // unscreened and without robust pruning, which could only cut short what a worker already rated in full
+        bomb_args rate_args = optim.args;
+        rate_args.screen = nullptr;
+        optim.eval_count = res.evals;
+        for (const vector<float>& arg : res.result_args) {
+            if (arg.size() != lower_bounds.size()) continue;
+            run.robust.reset();
+            opt_val_wrap rated = do_sim(arg, rate_args);
+            if (optimiser_t::better_than(rated, optim.best_result, optimise_maximise)) {
+                optim.best_arg = arg;
+                optim.best_result = rated;
+            }
+            if (top_k != 0) optim.insert_top(optim.top_results, arg, rated, top_k);
+        }
+        if (json_out.is_open()) {
+            for (size_t i = 0; i < optim.top_results.size(); ++i) {
+                write_json(optim.top_results[i].second, i);
+            }
+        }
+    } else {
+        optim.find_best();
+    }
+    if (run.screen.enabled() && n_workers == 0) {
+        log([&]{ return format("Screening discarded {} of {} candidates", run.screen.discarded(), optim.eval_count.load()); }, log_level, LOG_BASIC);
+    }
+
+    cout.clear();
+    if (!simple_output && !optim.sensitivity.empty()) {
+        vector<string> dim_names = {"Mix-to temp", "Fuel temp", "Primer temp", "Fill pressure"};
+        for (size_t i = 1; i < mix_gases.size(); ++i) dim_names.push_back(format("Mix {}", mix_gases[i].name()));
+        for (size_t i = 1; i < primer_gases.size(); ++i) dim_names.push_back(format("Primer {}", primer_gases[i].name()));
+        cout << "\nSensitivity (mean absolute effect of a 2/3-of-bounds change, its deviation, valid/invalid flips):" << endl;
+        for (size_t d = 0; d < optim.sensitivity.size(); ++d) {
+            const auto& sens = optim.sensitivity[d];
+            if (optim.lower_bounds[d] == optim.upper_bounds[d]) continue;
+            cout << format("{}: {:.4g} +-{:.4g}, {} flips{}", dim_names[d], sens.mu_star, sens.sigma, sens.validity_flips,
+                           sens.frozen ? format(", frozen at {}", optim.fixed_at[d]) : "") << endl;
+        }
+    }
+    if (!simple_output && optim.top_results.size() > 1) {
+        cout << format("\nTop {}:", optim.top_results.size()) << endl;
+        for (size_t i = 0; i < optim.top_results.size(); ++i) {
+            const opt_val_wrap& res = optim.top_results[i].second;
+            cout << format("{}. {}: {}", i + 1, res.rating_str(), res.data->serialize()) << endl;
+        }
+    }
+    if (silent) {
+        cout.setstate(ios::failbit);
+    }
 
     const opt_val_wrap& best_res = optim.best_result;
     cout.clear();
     if (best_res.data != nullptr) {
+        if (grid_partial && !simple_output) {
+            cout << "\nGrid scan was cancelled, so this is only the best of the points scanned." << endl;
+        }
         cout << (simple_output ? "" : "\nBest:\n") << (simple_output ? best_res.data->print_very_simple() : best_res.data->print_full()) << endl;
         if (!simple_output) {
             cout << "\nSerialized string: " << best_res.data->serialize() << endl;
         }
-        cout << default_tol << "x tolerances:\n" << best_res.data->measure_tolerances() << endl;
+        cout << default_tol << "x tolerances:\n" << best_res.data->measure_tolerances(default_tol, nthreads) << endl;
     } else {
         cout << "No viable recipes found." << endl;
     }
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+#include <argparse/read.hpp>
+
+#include "optimise.hpp"
+
+namespace asim {
+
+using optimiser_t = optimise_run::optimiser_t;
+
+static optimiser_t::init_mode_t parse_init_mode(std::string_view mode) {
+    if (mode == "uniform") return optimiser_t::init_uniform;
+    if (mode == "sobol") return optimiser_t::init_sobol;
+    if (mode == "lhs") return optimiser_t::init_lhs;
+    throw std::runtime_error(std::format("unknown init mode {}, expected uniform, sobol or lhs", mode));
+}
+
+static size_t ratio_count(const optimise_options& opts) {
+    return (opts.mix_gases.size() > 1 ? opts.mix_gases.size() - 1 : 0) + (opts.primer_gases.size() > 1 ? opts.primer_gases.size() - 1 : 0);
+}
+
+// the mix-to temperatures worth trying: above lower_target_temp, and between the fuel and primer temperatures
+static std::pair<float, float> target_range(const optimise_options& opts) {
+    return {std::max(opts.lower_target_temp, std::min(opts.mixt1, opts.thirt1)), std::max(opts.mixt2, opts.thirt2)};
+}
+
+void optimise_options::validate() const {
+    if (mix_gases.empty()) throw std::runtime_error("no mix gases given");
+    if (primer_gases.empty()) throw std::runtime_error("no primer gases given");
+    size_t num_ratios = ratio_count(*this);
+    if ((!ratio_lower.empty() || !ratio_upper.empty()) && (ratio_lower.size() != num_ratios || ratio_upper.size() != num_ratios)) {
+        throw std::runtime_error(std::format("expected {} ratio bounds, one for every gas after the first in each mix", num_ratios));
+    }
+    parse_init_mode(init_mode);
+    if (restarts && restart_growth <= 1.f) throw std::runtime_error("restartgrowth has to be above 1");
+}
+
+std::pair<std::vector<float>, std::vector<float>> optimise_options::bounds() const {
+    auto [target_lower, target_upper] = target_range(*this);
+    std::vector<float> lower = {target_lower, mixt1, thirt1, lower_pressure};
+    std::vector<float> upper = {target_upper, mixt2, thirt2, upper_pressure};
+    // solving takes the range from target_solve_args instead
+    if (!mix_to_iter || mix_to_solve) upper[0] = lower[0];
+    size_t num_ratios = ratio_count(*this);
+    // validate() refuses ratio bounds of the wrong count
+    if (ratio_lower.size() == num_ratios && ratio_upper.size() == num_ratios) {
+        lower.insert(lower.end(), ratio_lower.begin(), ratio_lower.end());
+        upper.insert(upper.end(), ratio_upper.begin(), ratio_upper.end());
+    } else {
+        lower.resize(4 + num_ratios, -ratio_bound);
+        upper.resize(4 + num_ratios, ratio_bound);
+    }
+    return {lower, upper};
+}
+
+std::string optimise_options::to_json_fields() const {
+    auto gas_list = [](const std::vector<gas_ref>& gases) {
+        std::string out;
+        for (gas_ref gas : gases) out += (out.empty() ? "" : ",") + json_string(gas.name());
+        return "[" + out + "]";
+    };
+    auto number_list = [](const auto& values) {
+        std::string out;
+        for (auto v : values) out += (out.empty() ? "" : ",") + json_number((float)v);
+        return "[" + out + "]";
+    };
+    // same syntax as the flags, with - for no bound
+    auto restriction_list = [](const std::vector<field_restriction<bomb_data>>& restrictions) {
+        std::string out;
+        auto bound = [](float v) { return std::abs(v) == std::numeric_limits<float>::max() ? std::string("-") : std::format("{}", v); };
+        for (const auto& re : restrictions) {
+            out += std::format("{}[{},{},{}]", out.empty() ? "" : ",", field_name(re.field), bound(re.min_v), bound(re.max_v));
+        }
+        return json_string("[" + out + "]");
+    };
+    auto json_bool = [](bool b) { return b ? "true" : "false"; };
+
+    std::string out = std::format("\"mix\":{},\"primer\":{},\"mixt\":[{},{}],\"thirt\":[{},{}],\"pressure\":[{},{}],\"lowertargettemp\":{},"
+                                  "\"mixtoiter\":{},\"mixtosolve\":{},\"ratiob\":{}",
+                                  gas_list(mix_gases), gas_list(primer_gases), json_number(mixt1), json_number(mixt2), json_number(thirt1), json_number(thirt2),
+                                  json_number(lower_pressure), json_number(upper_pressure), json_number(lower_target_temp),
+                                  json_bool(mix_to_iter), json_bool(mix_to_solve), json_number(ratio_bound));
+    if (!ratio_lower.empty() || !ratio_upper.empty()) {
+        out += std::format(",\"ratiolower\":{},\"ratioupper\":{}", number_list(ratio_lower), number_list(ratio_upper));
+    }
+    // no limit is left out rather than written as a number too big for most JSON readers
+    if (tick_cap != std::numeric_limits<size_t>::max()) out += std::format(",\"ticks\":{}", tick_cap);
+    out += std::format(",\"roundtemp\":{},\"roundpressure\":{},\"roundratio\":{},\"param\":{},\"maximise\":{},\"measurebefore\":{},"
+                       "\"restrictpre\":{},\"restrictpost\":{},\"robust\":[{},{},{}],\"robustquantile\":{},\"screen\":{},\"screenkeep\":{}",
+                       json_number(round_temp_to), json_number(round_pressure_to), json_number(round_ratio_to), json_string(field_name(opt_param)),
+                       json_bool(maximise), json_bool(measure_before), restriction_list(pre_restrictions), restriction_list(post_restrictions),
+                       json_number(robust_temp), json_number(robust_pressure), json_number(robust_ratio), json_number(robust_quantile),
+                       number_list(screen_horizons), json_number(screen_keep));
+    out += std::format(",\"init\":{},\"runtime\":{},\"rounds\":{},\"boundsscale\":{},\"maxevals\":{},\"stallgens\":{},\"stalleps\":{},"
+                       "\"restarts\":{},\"restartgrowth\":{},\"surrogate\":{},\"surrogatek\":{},\"surrogateexplore\":{},\"sensitivity\":{},\"freezebelow\":{}",
+                       json_string(init_mode), json_number(runtime), rounds, json_number(bounds_scale), max_evals, stall_gens, json_number(stall_eps),
+                       json_bool(restarts), json_number(restart_growth), surrogate_size, surrogate_k, json_number(surrogate_explore),
+                       sensitivity_trajectories, json_number(freeze_threshold));
+    return out;
+}
+
+optimise_options optimise_options::from_json(const json_object& obj) {
+    auto get_gases = [&](std::string_view key) {
+        std::vector<gas_ref> gases;
+        for (const std::string& name : obj.get_strings(key)) {
+            if (!is_valid_gas(name)) throw std::runtime_error(std::format("unknown gas {}", name));
+            gases.push_back(string_gas_map.at(name));
+        }
+        return gases;
+    };
+    auto get_range = [&](std::string_view key, float& min, float& max, bool required) {
+        std::vector<float> range = obj.get_floats(key);
+        if (range.empty() && !required) return;
+        if (range.size() != 2) throw std::runtime_error(std::format("expected [min, max] for {}", key));
+        min = range[0];
+        max = range[1];
+    };
+    // same syntax as the flags
+    auto get_restrictions = [&](std::string_view key, std::vector<field_restriction<bomb_data>>& restrictions) {
+        if (obj.has(key)) restrictions = argp::parse_value<std::vector<field_restriction<bomb_data>>>(obj.get_string(key));
+    };
+
+    optimise_options opts;
+    opts.mix_gases = get_gases("mix");
+    opts.primer_gases = get_gases("primer");
+    get_range("mixt", opts.mixt1, opts.mixt2, true);
+    get_range("thirt", opts.thirt1, opts.thirt2, true);
+    get_range("pressure", opts.lower_pressure, opts.upper_pressure, false);
+    opts.lower_target_temp = obj.get_float("lowertargettemp", opts.lower_target_temp);
+    opts.mix_to_iter = obj.get_bool("mixtoiter", opts.mix_to_iter);
+    opts.mix_to_solve = obj.get_bool("mixtosolve", opts.mix_to_solve);
+    opts.ratio_bound = obj.get_float("ratiob", opts.ratio_bound);
+    opts.ratio_lower = obj.get_floats("ratiolower");
+    opts.ratio_upper = obj.get_floats("ratioupper");
+    opts.tick_cap = obj.get_size("ticks", opts.tick_cap);
+    opts.round_temp_to = obj.get_float("roundtemp", opts.round_temp_to);
+    opts.round_pressure_to = obj.get_float("roundpressure", opts.round_pressure_to);
+    opts.round_ratio_to = obj.get_float("roundratio", opts.round_ratio_to);
+    if (obj.has("param")) opts.opt_param = argp::parse_value<field_ref<bomb_data>>(obj.get_string("param"));
+    opts.maximise = obj.get_bool("maximise", opts.maximise);
+    opts.measure_before = obj.get_bool("measurebefore", opts.measure_before);
+    get_restrictions("restrictpre", opts.pre_restrictions);
+    get_restrictions("restrictpost", opts.post_restrictions);
+    std::vector<float> robust = obj.get_floats("robust");
+    if (!robust.empty()) {
+        if (robust.size() != 3) throw std::runtime_error("expected [temp, pressure, ratio] for robust");
+        opts.robust_temp = robust[0];
+        opts.robust_pressure = robust[1];
+        opts.robust_ratio = robust[2];
+    }
+    opts.robust_quantile = obj.get_float("robustquantile", opts.robust_quantile);
+    for (float ticks : obj.get_floats("screen")) opts.screen_horizons.push_back((size_t)ticks);
+    opts.screen_keep = obj.get_float("screenkeep", opts.screen_keep);
+    opts.init_mode = obj.get_string("init", opts.init_mode);
+    opts.runtime = obj.get_float("runtime", opts.runtime);
+    opts.rounds = obj.get_size("rounds", opts.rounds);
+    opts.bounds_scale = obj.get_float("boundsscale", opts.bounds_scale);
+    opts.max_evals = obj.get_size("maxevals", opts.max_evals);
+    opts.stall_gens = obj.get_size("stallgens", opts.stall_gens);
+    opts.stall_eps = obj.get_float("stalleps", opts.stall_eps);
+    opts.restarts = obj.get_bool("restarts", opts.restarts);
+    opts.restart_growth = obj.get_float("restartgrowth", opts.restart_growth);
+    opts.surrogate_size = obj.get_size("surrogate", opts.surrogate_size);
+    opts.surrogate_k = obj.get_size("surrogatek", opts.surrogate_k);
+    opts.surrogate_explore = obj.get_float("surrogateexplore", opts.surrogate_explore);
+    opts.sensitivity_trajectories = obj.get_size("sensitivity", opts.sensitivity_trajectories);
+    opts.freeze_threshold = obj.get_float("freezebelow", opts.freeze_threshold);
+    return opts;
+}
+
+static const optimise_options& validated(const optimise_options& opts) {
+    opts.validate();
+    return opts;
+}
+
+static target_solve_args solve_range(const optimise_options& opts) {
+    if (!opts.mix_to_solve) return {};
+    auto [lower, upper] = target_range(opts);
+    return {lower, upper, opts.maximise};
+}
+
+optimise_run::optimise_run(const optimise_options& options, size_t log_level)
+:
+    opts(validated(options)),
+    screen(opts.screen_horizons, std::clamp(opts.screen_keep, 0.f, 1.f)),
+    solve_target(solve_range(opts)),
+    optim(do_sim,
+          opts.bounds().first,
+          opts.bounds().second,
+          opts.maximise,                                                                             // convert percentage to fraction
+          {opts.mix_gases, opts.primer_gases, opts.measure_before, opts.round_pressure_to, opts.round_temp_to, opts.round_ratio_to * 0.01f,
+           opts.tick_cap, opts.opt_param, opts.pre_restrictions, opts.post_restrictions, &robust, &screen, &solve_target},
+          as_seconds(opts.runtime),
+          opts.rounds,
+          opts.bounds_scale,
+          log_level) {
+
+    robust.temp_delta = opts.robust_temp;
+    robust.pressure_delta = opts.robust_pressure;
+    robust.ratio_delta = opts.robust_ratio * 0.01f;
+    robust.quantile = std::clamp(opts.robust_quantile, 0.f, 1.f);
+    robust.maximise = opts.maximise;
+
+    optim.on_start = [this] { robust.reset(); };
+    optim.max_evals = opts.max_evals;
+    optim.stall_generations = opts.stall_gens;
+    optim.stall_epsilon = opts.stall_eps;
+    optim.restart_on_stall = opts.restarts;
+    optim.restart_pop_growth = opts.restart_growth;
+    optim.surrogate_size = opts.surrogate_size;
+    optim.surrogate_k = opts.surrogate_k;
+    optim.surrogate_explore = opts.surrogate_explore;
+    optim.sensitivity_trajectories = opts.sensitivity_trajectories;
+    optim.freeze_threshold = opts.freeze_threshold;
+    optim.init_mode = parse_init_mode(opts.init_mode);
+    // populations narrower than what we round to can't find anything new
+    optim.min_spread = {opts.round_temp_to, opts.round_temp_to, opts.round_temp_to, opts.round_pressure_to};
+    optim.min_spread.resize(optim.lower_bounds.size(), opts.round_ratio_to * 0.01f);
+}
+
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+#include "server.hpp"
+#include "batch.hpp"
+#include "constants.hpp"
+#include "gas.hpp"
+#include "optimise.hpp"
+#include "sim.hpp"
+
+namespace asim {
+
+server::server(size_t n_threads, std::ostream& out): out(out), pool(std::max((size_t)1, n_threads) + 1) {}
+
+void server::serve(std::istream& in) {
+    std::string line;
+    while (!status_SIGINT && std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+        if (!handle(line)) break;
+    }
+    std::unique_lock lock(jobs_mutex);
+    jobs_cv.wait(lock, [this]{ return running == 0; });
+}
+
+void server::reply(const std::string& id_json, std::string body) {
+    // splice the id in front of the body's fields
+    std::string line = std::format("{{\"id\":{}{}{}", id_json, body.size() > 2 ? "," : "", std::string_view(body).substr(1));
+    std::lock_guard lock(out_mutex);
+    out << line << '\n';
+    out.flush();
+}
+
+void server::submit_job(const std::string& id_json, std::function<std::string(const std::atomic<bool>&)> fn) {
+    std::shared_ptr<job> new_job = std::make_shared<job>();
+    {
+        std::lock_guard lock(jobs_mutex);
+        if (id_json != "null") {
+            if (jobs.contains(id_json)) throw std::runtime_error("a job with this id is already running");
+            jobs[id_json] = new_job;
+        }
+        ++running;
+    }
+    pool.submit([this, id_json, new_job, fn = std::move(fn)] {
+        std::string body;
+        try {
+            body = fn(new_job->cancel);
+        } catch (const std::exception& e) {
+            body = std::format("{{\"error\":{}}}", json_string(e.what()));
+        }
+        reply(id_json, std::move(body));
+        ++jobs_done;
+
+        std::lock_guard lock(jobs_mutex);
+        jobs.erase(id_json);
+        --running;
+        jobs_cv.notify_all();
+    });
+}
+
+bool server::handle(std::string_view line) {
+    std::string id_json = "null";
+    try {
+        json_object req = json_object::parse(line);
+        auto id_it = req.values.find("id");
+        if (id_it != req.values.end()) id_json = id_it->second.json();
+        std::string op = req.get_string("op");
+
+        if (op == "simulate" || op == "tolerance") {
+            batch_options opts;
+            opts.tick_cap = req.get_size("ticks", opts.tick_cap);
+            opts.tolerances = op == "tolerance";
+            opts.tol = req.get_float("tol", opts.tol);
+            std::string recipe = req.get_string("recipe");
+            std::string key = std::format("{}\n{}\n{}\n{}", op, opts.tick_cap, opts.tol, recipe);
+            {
+                std::lock_guard lock(cache_mutex);
+                auto it = result_cache.find(key);
+                if (it != result_cache.end()) {
+                    ++cache_hits;
+                    reply(id_json, it->second);
+                    return true;
+                }
+            }
+            submit_job(id_json, [this, opts, recipe = std::move(recipe), key = std::move(key)](const std::atomic<bool>&) {
+                std::string res = simulate_recipe_json(recipe, opts, pool);
+                std::lock_guard lock(cache_mutex);
+                if (result_cache.size() >= max_cache_size) result_cache.clear();
+                result_cache[key] = res;
+                return res;
+            });
+        } else if (op == "optimise") {
+            submit_job(id_json, [this, req = std::move(req)](const std::atomic<bool>& cancel) {
+                return optimise(req, cancel);
+            });
+        } else if (op == "cancel") {
+            auto job_it = req.values.find("job");
+            if (job_it == req.values.end()) throw std::runtime_error("no job to cancel given");
+            bool found = false;
+            {
+                std::lock_guard lock(jobs_mutex);
+                auto it = jobs.find(job_it->second.json());
+                if (it != jobs.end()) {
+                    it->second->cancel = true;
+                    found = true;
+                }
+            }
+            reply(id_json, std::format("{{\"cancelled\":{}}}", found ? "true" : "false"));
+        } else if (op == "stats") {
+            size_t n_running, n_cached;
+            {
+                std::lock_guard lock(jobs_mutex);
+                n_running = running;
+            }
+            {
+                std::lock_guard lock(cache_mutex);
+                n_cached = result_cache.size();
+            }
+            reply(id_json, std::format("{{\"threads\":{},\"running\":{},\"done\":{},\"cached\":{},\"cache_hits\":{}}}",
+                                       pool.size() - 1, n_running, jobs_done.load(), n_cached, cache_hits.load()));
+        } else if (op == "shutdown") {
+            reply(id_json, "{}");
+            return false;
+        } else {
+            throw std::runtime_error(std::format("unknown op '{}', expected simulate, tolerance, optimise, cancel, stats or shutdown", op));
+        }
+    } catch (const std::exception& e) {
+        reply(id_json, std::format("{{\"error\":{}}}", json_string(e.what())));
+    }
+    return true;
+}
+
+std::string server::optimise(const json_object& req, const std::atomic<bool>& cancel) {
+    optimise_run run(optimise_options::from_json(req));
+    optimise_run::optimiser_t& optim = run.optim;
+    optim.n_threads = std::clamp(req.get_size("threads", pool.size() - 1), (size_t)1, pool.size() - 1);
+    optim.pool = &pool;
+    optim.cancel_flag = &cancel;
+    // optimiser arguments of a known good result to start from, as given back in "arg"
+    std::vector<float> seed = req.get_floats("seed");
+    if (!seed.empty()) {
+        if (seed.size() != optim.lower_bounds.size()) throw std::runtime_error(std::format("expected {} values for seed", optim.lower_bounds.size()));
+        for (size_t i = 0; i < seed.size(); ++i) seed[i] = std::clamp(seed[i], optim.lower_bounds[i], optim.upper_bounds[i]);
+        optim.best_arg = seed;
+        optim.best_result = do_sim(seed, optim.args);
+    }
+    optim.find_best();
+
+    if (!optim.best_result.valid()) throw std::runtime_error("no valid bomb found");
+    std::string arg_json;
+    for (float f : optim.best_arg) arg_json += (arg_json.empty() ? "" : ",") + json_number(f);
+    return optim.best_result.data->to_json(std::format("\"evals\":{},\"cancelled\":{},\"arg\":[{}]", optim.eval_count.load(), cancel ? "true" : "false", arg_json));
+}
+
+}
@@ -1,6 +1,13 @@
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <random>
 
 #include "sim.hpp"
 #include "constants.hpp"
@@ -9,13 +16,39 @@
 
 namespace asim {
 
-void bomb_data::sim_ticks(size_t up_to, field_ref<bomb_data> optstat_ref, bool measure_pre) {
+bool bomb_data::sim_ticks(size_t up_to, field_ref<bomb_data> optstat_ref, bool measure_pre, const screen_args* screen) {
     if (measure_pre) {
         fin_pressure = tank.mix.pressure();
         optstat = optstat_ref.get(*this);
     }
 
-    size_t a_ticks = tank.tick_n(up_to);
+    size_t a_ticks = 0;
+    bool stopped = false, promoted = true;
+    if (screen) {
+        float last_pressure = tank.mix.pressure();
+        for (size_t stage = 0; stage < screen->horizons.size(); ++stage) {
+            size_t horizon = screen->horizons[stage];
+            if (horizon >= up_to) break;
+            if (horizon <= a_ticks) continue;
+            size_t from = a_ticks;
+            a_ticks += tank.tick_n(horizon - a_ticks, stopped);
+            if (stopped) break;
+
+            // a leaking tank is about to resolve one way or another, otherwise extrapolate how the pressure is going
+            float pressure = tank.mix.pressure();
+            float trend = (pressure - last_pressure) / (a_ticks - from);
+            float projected = tank.integrity < 3 ? tank_fragment_pressure
+                            : std::min(tank_fragment_pressure, pressure + std::max(0.f, trend) * (up_to - a_ticks));
+            if (!screen->promote(stage, projected)) {
+                promoted = false;
+                break;
+            }
+            last_pressure = pressure;
+        }
+    }
+    if (!stopped && promoted) {
+        a_ticks += tank.tick_n(up_to - a_ticks);
+    }
 
     ticks = a_ticks;
     fin_pressure = tank.mix.pressure();
@@ -23,6 +56,7 @@ void bomb_data::sim_ticks(size_t up_to, field_ref<bomb_data> optstat_ref, bool m
 
     if (!measure_pre)
         optstat = optstat_ref.get(*this);
+    return promoted;
 }
 
 std::string bomb_data::mix_string(const std::vector<gas_ref>& gases, const std::vector<float>& fractions) const {
@@ -34,168 +68,633 @@ std::string bomb_data::mix_string(const std::vector<gas_ref>& gases, const std::
     return out;
 }
 
-// [[gas1,frac1],[gas2,frac2],...]
-std::string bomb_data::mix_string_simple(const std::vector<gas_ref>& gases, const std::vector<float>& fractions) const {
-    std::string out = "[";
+// [[gas1,frac1],[gas2,frac2],...], with ratios multiplied by scale
+static void append_mix_simple(std::string& out, const std::vector<gas_ref>& gases, const std::vector<float>& ratios, float scale) {
+    out += '[';
     for (size_t i = 0; i < gases.size(); ++i) {
-        out += std::format("[{},{}]", gases[i].name(), fractions[i]);
-        if (i != gases.size() - 1) out += ",";
+        std::format_to(std::back_inserter(out), "{}[{},{}]", i == 0 ? "" : ",", gases[i].name(), ratios[i] * scale);
     }
-    return out + "]";
+    out += ']';
+}
+
+static float inverse_sum(const std::vector<float>& vec) {
+    return 1.f / std::accumulate(vec.begin(), vec.end(), 0.f);
+}
+
+std::string bomb_data::mix_string_simple(const std::vector<gas_ref>& gases, const std::vector<float>& fractions) const {
+    std::string out;
+    append_mix_simple(out, gases, fractions, 1.f);
+    return out;
 }
 
 std::string bomb_data::print_very_simple() const {
     std::string out_str;
-    std::vector<float> mix_fractions = get_fractions(mix_ratios);
-    std::vector<float> primer_fractions = get_fractions(primer_ratios);
     // note: this format is supposed to be script-friendly and backwards-compatible
-    out_str += std::format("os={} ti={} ft={} fp={} tp={} mt={} tt={} mi={} pm={}", optstat, ticks, fuel_temp, fuel_pressure, to_pressure, mix_to_temp, thir_temp, mix_string_simple(mix_gases, mix_fractions), mix_string_simple(primer_gases, primer_fractions));
+    std::format_to(std::back_inserter(out_str), "os={} ti={} ft={} fp={} tp={} mt={} tt={} mi=", optstat, ticks, fuel_temp, fuel_pressure, to_pressure, mix_to_temp, thir_temp);
+    append_mix_simple(out_str, mix_gases, mix_ratios, inverse_sum(mix_ratios));
+    out_str += " pm=";
+    append_mix_simple(out_str, primer_gases, primer_ratios, inverse_sum(primer_ratios));
     return out_str;
 }
 
 std::string bomb_data::serialize() const {
     std::string out_str;
-    std::vector<float> mix_fractions = get_fractions(mix_ratios);
-    std::vector<float> primer_fractions = get_fractions(primer_ratios);
-    out_str += std::format("ft={} fp={} tp={} tt={} mi={} pm={}", fuel_temp, fuel_pressure, to_pressure, thir_temp, mix_string_simple(mix_gases, mix_fractions), mix_string_simple(primer_gases, primer_fractions));
+    out_str.reserve(128);
+    std::format_to(std::back_inserter(out_str), "ft={} fp={} tp={} tt={} mi=", fuel_temp, fuel_pressure, to_pressure, thir_temp);
+    append_mix_simple(out_str, mix_gases, mix_ratios, inverse_sum(mix_ratios));
+    out_str += " pm=";
+    append_mix_simple(out_str, primer_gases, primer_ratios, inverse_sum(primer_ratios));
     return out_str;
 }
 
+std::string bomb_data::to_json(std::string_view extra_fields) const {
+    std::string out = "{";
+    if (!extra_fields.empty()) {
+        out += extra_fields;
+        out += ',';
+    }
+    out += std::format("\"ticks\":{},\"radius\":{},\"pressure\":{},\"state\":{},\"optstat\":{},\"recipe\":{}}}",
+                       ticks, json_number(fin_radius), json_number(fin_pressure), json_string(tank.state_name()),
+                       json_number(optstat), json_string(serialize()));
+    return out;
+}
+
+// parses a float taking up all of str
+static float parse_recipe_float(std::string_view str, std::string_view key) {
+    float out;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+    if (ec != std::errc() || ptr != str.data() + str.size()) {
+        throw std::runtime_error(std::format("bad value for {}: '{}'", key, str));
+    }
+    return out;
+}
+
+// parses [[gas1,ratio1],[gas2,ratio2],...]
+static void parse_recipe_mix(std::string_view str, std::string_view key, std::vector<gas_ref>& gases, std::vector<float>& ratios) {
+    auto fail = [&]() {
+        throw std::runtime_error(std::format("bad value for {}: '{}'", key, str));
+    };
+    if (str.size() < 2 || str.front() != '[' || str.back() != ']') fail();
+    std::string_view rest = str.substr(1, str.size() - 2);
+    while (!rest.empty()) {
+        size_t close = rest.find(']');
+        size_t comma = rest.find(',');
+        if (rest.front() != '[' || close == std::string_view::npos || comma > close) fail();
+
+        std::string_view name = rest.substr(1, comma - 1);
+        auto gas = std::find_if(std::begin(gas_types), std::end(gas_types), [name](const gas_type& g) { return g.name == name; });
+        if (gas == std::end(gas_types)) {
+            throw std::runtime_error(std::format("unknown gas {} in {}", name, key));
+        }
+        gases.push_back({(size_t)(gas - std::begin(gas_types))});
+        ratios.push_back(parse_recipe_float(rest.substr(comma + 1, close - comma - 1), key));
+
+        rest.remove_prefix(close + 1);
+        if (!rest.empty()) {
+            if (rest.front() != ',' || rest.size() == 1) fail();
+            rest.remove_prefix(1);
+        }
+    }
+    if (gases.empty()) fail();
+}
+
 bomb_data bomb_data::deserialize(std::string_view str) {
-    std::map<std::string, std::string> kv_pairs;
-    size_t start = 0;
-    // parse k=v into map
-    while (start < str.size()) {
-        size_t eq_pos = str.find('=', start);
-        if (eq_pos == std::string_view::npos) break;
-        std::string key(str.substr(start, eq_pos - start));
-        size_t space_pos = str.find(' ', eq_pos);
-        if (space_pos == std::string_view::npos) space_pos = str.size();
-        std::string value(str.substr(eq_pos + 1, space_pos - eq_pos - 1));
-        kv_pairs[key] = value;
-        start = space_pos + 1;
-    }
-
-    float fuel_temp = argp::parse_value<float>(kv_pairs["ft"]);
-    float fuel_pressure = argp::parse_value<float>(kv_pairs["fp"]);
-    float to_pressure = argp::parse_value<float>(kv_pairs["tp"]);
-    float thir_temp = argp::parse_value<float>(kv_pairs["tt"]);
-    auto mix_gases = argp::parse_value<std::vector<std::pair<gas_ref, float>>>(kv_pairs["mi"]);
-    auto primer_gases = argp::parse_value<std::vector<std::pair<gas_ref, float>>>(kv_pairs["pm"]);
-
-    // try to reconstruct the tank
-    gas_tank tank;
-    tank.mix.canister_fill_to(mix_gases, fuel_temp, fuel_pressure);
-    tank.mix.canister_fill_to(primer_gases, thir_temp, to_pressure);
+    // split into space-separated k=v pairs, ignoring keys we don't need
+    std::string_view values[6];
+    const std::string_view keys[6] = {"ft", "fp", "tp", "tt", "mi", "pm"};
+    while (!str.empty()) {
+        size_t space_pos = std::min(str.find(' '), str.size());
+        std::string_view pair = str.substr(0, space_pos);
+        str.remove_prefix(std::min(space_pos + 1, str.size()));
+        size_t eq_pos = pair.find('=');
+        if (eq_pos == std::string_view::npos) continue;
+        auto key = std::find(std::begin(keys), std::end(keys), pair.substr(0, eq_pos));
+        if (key != std::end(keys)) values[key - std::begin(keys)] = pair.substr(eq_pos + 1);
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        if (values[i].empty()) throw std::runtime_error(std::format("missing {} in serialised recipe", keys[i]));
+    }
 
     std::vector<float> mix_ratios, primer_ratios;
     std::vector<gas_ref> mix_refs, primer_refs;
-    for (const auto& [k, v] : mix_gases) {
-        mix_ratios.push_back(v);
-        mix_refs.push_back(k);
+    parse_recipe_mix(values[4], keys[4], mix_refs, mix_ratios);
+    parse_recipe_mix(values[5], keys[5], primer_refs, primer_ratios);
+
+    bomb_data data(
+        std::move(mix_ratios),
+        std::move(primer_ratios),
+        parse_recipe_float(values[2], keys[2]),
+        parse_recipe_float(values[0], keys[0]),
+        parse_recipe_float(values[1], keys[1]),
+        parse_recipe_float(values[3], keys[3]),
+        0.f,
+        mix_refs,
+        primer_refs,
+        {}
+    );
+    // reconstruct the tank
+    data.tank = data.build_tank();
+    data.mix_to_temp = data.tank.mix.temperature;
+    return data;
+}
+
+recipe_record bomb_data::to_record() const {
+    if (mix_gases.size() + primer_gases.size() > recipe_record::max_gases) {
+        throw std::runtime_error(std::format("recipes with over {} gases don't fit in a record", recipe_record::max_gases));
+    }
+    recipe_record rec{};
+    rec.fuel_temp = fuel_temp;
+    rec.fuel_pressure = fuel_pressure;
+    rec.to_pressure = to_pressure;
+    rec.thir_temp = thir_temp;
+    rec.mix_count = mix_gases.size();
+    rec.primer_count = primer_gases.size();
+    std::fill(std::begin(rec.gases), std::end(rec.gases), 0xff);
+    float mix_scale = inverse_sum(mix_ratios), primer_scale = inverse_sum(primer_ratios);
+    for (size_t i = 0; i < mix_gases.size(); ++i) {
+        rec.gases[i] = mix_gases[i].idx;
+        rec.fractions[i] = mix_ratios[i] * mix_scale;
     }
-    for (const auto& [k, v] : primer_gases) {
-        primer_ratios.push_back(v);
-        primer_refs.push_back(k);
+    for (size_t i = 0; i < primer_gases.size(); ++i) {
+        rec.gases[rec.mix_count + i] = primer_gases[i].idx;
+        rec.fractions[rec.mix_count + i] = primer_ratios[i] * primer_scale;
+    }
+    return rec;
+}
+
+bomb_data bomb_data::from_record(const recipe_record& rec) {
+    size_t total = (size_t)rec.mix_count + rec.primer_count;
+    if (rec.mix_count == 0 || rec.primer_count == 0 || total > recipe_record::max_gases) {
+        throw std::runtime_error("invalid recipe record");
+    }
+    std::vector<gas_ref> mix_refs(rec.mix_count), primer_refs(rec.primer_count);
+    for (size_t i = 0; i < total; ++i) {
+        if (rec.gases[i] >= gas_count) throw std::runtime_error(std::format("invalid gas index {} in recipe record", rec.gases[i]));
+        (i < rec.mix_count ? mix_refs[i] : primer_refs[i - rec.mix_count]) = {rec.gases[i]};
     }
 
     bomb_data data(
-        mix_ratios,
-        primer_ratios,
-        to_pressure,
-        fuel_temp,
-        fuel_pressure,
-        thir_temp,
-        tank.mix.temperature,
+        std::vector<float>(rec.fractions, rec.fractions + rec.mix_count),
+        std::vector<float>(rec.fractions + rec.mix_count, rec.fractions + total),
+        rec.to_pressure,
+        rec.fuel_temp,
+        rec.fuel_pressure,
+        rec.thir_temp,
+        0.f,
         mix_refs,
         primer_refs,
-        std::move(tank),
-        false
+        {}
     );
+    data.tank = data.build_tank();
+    data.mix_to_temp = data.tank.mix.temperature;
     return data;
 }
 
-// this is kinda cursed but if it works it works
-std::string bomb_data::measure_tolerances(float min_ratio) const {
-    const size_t measure_iters = 100;
+float& recipe_param::of(bomb_data& data) const {
+    switch (type) {
+        case (fuel_temp_p): return data.fuel_temp;
+        case (fuel_pressure_p): return data.fuel_pressure;
+        case (thir_temp_p): return data.thir_temp;
+        case (to_pressure_p): return data.to_pressure;
+        case (mix_ratio_p): return data.mix_ratios[index];
+        case (primer_ratio_p): return data.primer_ratios[index];
+    }
+    throw std::runtime_error("invalid recipe parameter");
+}
+
+float recipe_param::of(const bomb_data& data) const {
+    return of(const_cast<bomb_data&>(data));
+}
+
+std::string recipe_param::name(const bomb_data& data) const {
+    switch (type) {
+        case (fuel_temp_p): return "Fuel temp";
+        case (fuel_pressure_p): return "Fuel pressure";
+        case (thir_temp_p): return "Primer temp";
+        case (to_pressure_p): return "Release pressure";
+        case (mix_ratio_p): return std::format("Mix {}", data.mix_gases[index].name());
+        case (primer_ratio_p): return std::format("Primer {}", data.primer_gases[index].name());
+    }
+    throw std::runtime_error("invalid recipe parameter");
+}
+
+std::string recipe_param::key() const {
+    switch (type) {
+        case (fuel_temp_p): return "ft";
+        case (fuel_pressure_p): return "fp";
+        case (thir_temp_p): return "tt";
+        case (to_pressure_p): return "tp";
+        case (mix_ratio_p): return std::format("mi{}", index);
+        case (primer_ratio_p): return std::format("pm{}", index);
+    }
+    throw std::runtime_error("invalid recipe parameter");
+}
+
+recipe_param recipe_param::from_key(std::string_view key) {
+    if (key == "ft") return {fuel_temp_p};
+    if (key == "fp") return {fuel_pressure_p};
+    if (key == "tt") return {thir_temp_p};
+    if (key == "tp") return {to_pressure_p};
+    if (key.size() > 2 && (key.starts_with("mi") || key.starts_with("pm"))) {
+        size_t index = 0;
+        auto [ptr, ec] = std::from_chars(key.data() + 2, key.data() + key.size(), index);
+        if (ec == std::errc() && ptr == key.data() + key.size()) {
+            return {key.starts_with("mi") ? mix_ratio_p : primer_ratio_p, index};
+        }
+    }
+    throw std::runtime_error(std::format("unknown recipe parameter {}, expected ft, fp, tt, tp, miN or pmN", key));
+}
+
+float recipe_param::round_step(const bomb_data& data) const {
+    switch (type) {
+        case (fuel_temp_p): case (thir_temp_p): return data.round_temp_to;
+        case (fuel_pressure_p): case (to_pressure_p): return data.round_pressure_to;
+        // ratios are rounded as fractions
+        case (mix_ratio_p): return data.round_ratio_to * std::accumulate(data.mix_ratios.begin(), data.mix_ratios.end(), 0.f);
+        case (primer_ratio_p): return data.round_ratio_to * std::accumulate(data.primer_ratios.begin(), data.primer_ratios.end(), 0.f);
+    }
+    throw std::runtime_error("invalid recipe parameter");
+}
+
+std::vector<recipe_param> bomb_data::params() const {
+    std::vector<recipe_param> out = {{recipe_param::fuel_temp_p}, {recipe_param::fuel_pressure_p}, {recipe_param::thir_temp_p}, {recipe_param::to_pressure_p}};
+    if (mix_ratios.size() > 1) {
+        for (size_t i = 0; i < mix_ratios.size(); ++i) out.push_back({recipe_param::mix_ratio_p, i});
+    }
+    if (primer_ratios.size() > 1) {
+        for (size_t i = 0; i < primer_ratios.size(); ++i) out.push_back({recipe_param::primer_ratio_p, i});
+    }
+    return out;
+}
+
+gas_tank bomb_data::build_tank() const {
+    gas_tank out_tank;
+    out_tank.mix.canister_fill_to(mix_gases, get_fractions(mix_ratios), fuel_temp, fuel_pressure);
+    out_tank.mix.canister_fill_to(primer_gases, get_fractions(primer_ratios), thir_temp, to_pressure);
+    return out_tank;
+}
+
+gas_tank bomb_data::build_tank(std::span<const std::pair<recipe_param, float>> changes) const {
+    // only copy what we change, copying the whole bomb_data is comparatively expensive
+    float v_fuel_temp = fuel_temp, v_fuel_pressure = fuel_pressure, v_thir_temp = thir_temp, v_to_pressure = to_pressure;
+    std::vector<float> v_mix_ratios(mix_ratios), v_primer_ratios(primer_ratios);
+    for (const auto& [param, value] : changes) {
+        switch (param.type) {
+            case (recipe_param::fuel_temp_p): v_fuel_temp = value; break;
+            case (recipe_param::fuel_pressure_p): v_fuel_pressure = value; break;
+            case (recipe_param::thir_temp_p): v_thir_temp = value; break;
+            case (recipe_param::to_pressure_p): v_to_pressure = value; break;
+            case (recipe_param::mix_ratio_p): v_mix_ratios[param.index] = value; break;
+            case (recipe_param::primer_ratio_p): v_primer_ratios[param.index] = value; break;
+        }
+    }
+
+    gas_tank out_tank;
+    out_tank.mix.canister_fill_to(mix_gases, get_fractions(std::move(v_mix_ratios)), v_fuel_temp, v_fuel_pressure);
+    out_tank.mix.canister_fill_to(primer_gases, get_fractions(std::move(v_primer_ratios)), v_thir_temp, v_to_pressure);
+    return out_tank;
+}
+
+bool bomb_data::test_variation(recipe_param param, float value, float target_radius, float target_ticks, size_t tick_limit) const {
+    if (value < 0.f) return false;
+    std::pair<recipe_param, float> change{param, value};
+    gas_tank v_tank = build_tank({&change, 1});
+    size_t c_ticks = v_tank.tick_n(tick_limit);
+    return v_tank.calc_radius() >= target_radius && c_ticks >= target_ticks;
+}
+
+std::vector<param_tolerance> bomb_data::tolerances(float min_ratio, thread_pool& pool) const {
     const float target_radius = fin_radius * min_ratio;
     const float target_ticks = ticks * min_ratio;
-    std::string msg;
+    const size_t tick_limit = ticks / min_ratio;
+    // stop expanding past this many times the original value and report that as the bound
+    const float max_scale = 1000.f;
 
-    auto test_variation = [&](auto&& adjust_fn) -> bool {
-        bomb_data d_copy(*this);
-        adjust_fn(d_copy);
-        if (*std::min_element(d_copy.mix_ratios.begin(), d_copy.mix_ratios.end()) < 0.f) return false;
-        if (*std::min_element(d_copy.primer_ratios.begin(), d_copy.primer_ratios.end()) < 0.f) return false;
-        if (d_copy.fuel_temp < 0.f || d_copy.fuel_pressure < 0.f || d_copy.thir_temp < 0.f || d_copy.to_pressure < 0.f) return false;
-        gas_tank tank;
-        tank.mix.canister_fill_to(d_copy.mix_gases, get_fractions(d_copy.mix_ratios), d_copy.fuel_temp, d_copy.fuel_pressure);
-        tank.mix.canister_fill_to(d_copy.primer_gases, get_fractions(d_copy.primer_ratios), d_copy.thir_temp, d_copy.to_pressure);
-        size_t c_ticks = tank.tick_n(ticks / min_ratio);
-        return tank.calc_radius() >= target_radius && c_ticks >= target_ticks;
-    };
+    std::vector<recipe_param> c_params = params();
+    size_t n_searches = c_params.size() * 2;
+    // spare threads go towards probing several points per step within each search
+    size_t probes = std::max((size_t)1, (pool.size() + n_searches - 1) / n_searches);
+
+    // k-ary search on the lattice of the parameter's rounding step: expand exponentially while valid,
+    // then narrow down the first invalid interval until it's one step wide
+    // working in whole steps means no state gets simulated twice and we stop at printable precision
+    auto find_tolerance = [&](recipe_param param, float dir) -> float {
+        float start = param.of(*this);
+        float step = param.round_step(*this);
+        if (step <= 0.f) step = start == 0.f ? 1e-6f : std::abs(start) / 1024.f;
+        const int64_t max_steps = std::max((int64_t)1, (int64_t)(std::max(std::abs(start), step) * max_scale / step));
 
-    auto find_tolerance = [&](auto&& adjust_fn, float start, float dir) -> float {
-        float base = 0.f, adj = std::abs(start) / 1024.f;
-        float farthest = start;
-        bool had_invalid = false;
-        // binary search
-        for (size_t i = 0; i < measure_iters; ++i) {
-            float test_val = start + (base + adj) * dir;
-            bool valid = test_variation([&](bomb_data& c){ adjust_fn(c, test_val); });
-            if (valid) {
-                farthest = test_val;
-                base = base + adj;
-                adj *= had_invalid ? 0.5f : 2.f;
+        std::vector<int64_t> offsets;
+        std::vector<char> valid;
+        auto test_offsets = [&]() -> size_t {
+            valid.resize(offsets.size());
+            pool.parallel_for(offsets.size(), [&](size_t i) {
+                valid[i] = test_variation(param, start + offsets[i] * step * dir, target_radius, target_ticks, tick_limit);
+            });
+            // how many leading probes were valid
+            return std::find(valid.begin(), valid.end(), (char)false) - valid.begin();
+        };
+
+        // expansion, probing at base + 1, 2, 4... steps
+        int64_t lo = 0, hi = -1, adj = 1;
+        while (hi < 0) {
+            offsets.clear();
+            for (size_t i = 0; i < probes && lo + (adj << i) <= max_steps; ++i) {
+                offsets.push_back(lo + (adj << i));
+            }
+            if (offsets.empty()) return start + max_steps * step * dir;
+            size_t n_valid = test_offsets();
+            if (n_valid == offsets.size()) {
+                lo = offsets.back();
+                adj <<= offsets.size();
             } else {
-                adj *= 0.5f;
-                had_invalid = true;
+                if (n_valid != 0) lo = offsets[n_valid - 1];
+                hi = offsets[n_valid];
+            }
+        }
+
+        // bracketing, splitting (lo, hi) into probes + 1 parts
+        while (hi - lo > 1) {
+            offsets.clear();
+            for (size_t i = 0; i < probes; ++i) {
+                int64_t at = lo + (hi - lo) * (int64_t)(i + 1) / (int64_t)(probes + 1);
+                if (at > lo && at < hi && (offsets.empty() || offsets.back() != at)) offsets.push_back(at);
             }
+            size_t n_valid = test_offsets();
+            if (n_valid != 0) lo = offsets[n_valid - 1];
+            if (n_valid != offsets.size()) hi = offsets[n_valid];
         }
-        return farthest;
+        return start + lo * step * dir;
     };
 
-    auto find_tolerances = [&](auto&& adjust_fn, float start) -> std::pair<float, float> {
-        return {find_tolerance(adjust_fn, start, -1.f), find_tolerance(adjust_fn, start, 1.f)};
+    std::vector<float> results(n_searches);
+    pool.parallel_for(n_searches, [&](size_t i) {
+        results[i] = find_tolerance(c_params[i / 2], i % 2 == 0 ? -1.f : 1.f);
+    });
+
+    std::vector<param_tolerance> out;
+    float mix_sum = std::accumulate(mix_ratios.begin(), mix_ratios.end(), 0.f);
+    float primer_sum = std::accumulate(primer_ratios.begin(), primer_ratios.end(), 0.f);
+    for (size_t i = 0; i < c_params.size(); ++i) {
+        recipe_param param = c_params[i];
+        float min_v = results[i * 2], max_v = results[i * 2 + 1];
+        // convert ratios to fractions
+        if (param.type == recipe_param::mix_ratio_p || param.type == recipe_param::primer_ratio_p) {
+            float sum = param.type == recipe_param::mix_ratio_p ? mix_sum : primer_sum;
+            float orig_ratio = param.of(*this);
+            min_v /= sum + min_v - orig_ratio;
+            max_v /= sum + max_v - orig_ratio;
+        }
+        out.push_back({param, min_v, max_v});
+    }
+    return out;
+}
+
+std::string bomb_data::measure_tolerances(float min_ratio, size_t n_threads) const {
+    thread_pool pool(n_threads);
+    return measure_tolerances(min_ratio, pool);
+}
+
+std::string bomb_data::measure_tolerances(float min_ratio, thread_pool& pool) const {
+    std::string msg;
+    for (const param_tolerance& tol : tolerances(min_ratio, pool)) {
+        switch (tol.param.type) {
+            case (recipe_param::fuel_temp_p):
+            case (recipe_param::thir_temp_p):
+                msg += std::format("  {}: {}K - {}K\n", tol.param.name(*this), tol.min_v, tol.max_v);
+                break;
+            case (recipe_param::fuel_pressure_p):
+            case (recipe_param::to_pressure_p):
+                msg += std::format("  {}: {}kPa - {}kPa\n", tol.param.name(*this), tol.min_v, tol.max_v);
+                break;
+            case (recipe_param::mix_ratio_p):
+            case (recipe_param::primer_ratio_p):
+                msg += std::format("  {}: {}% - {}%\n", tol.param.name(*this), tol.min_v * 100.f, tol.max_v * 100.f);
+                break;
+        }
+    }
+    return msg;
+}
+
+float mismix_dist::width(recipe_param param) const {
+    switch (param.type) {
+        case (recipe_param::fuel_temp_p):
+        case (recipe_param::thir_temp_p):
+            return temp_width;
+        case (recipe_param::fuel_pressure_p):
+        case (recipe_param::to_pressure_p):
+            return pressure_width;
+        default:
+            return ratio_width;
+    }
+}
+
+robustness_report bomb_data::robustness(size_t samples, const mismix_dist& dist, float min_ratio, thread_pool& pool, uint64_t seed) const {
+    const float target_radius = fin_radius * min_ratio;
+    const float target_ticks = ticks * min_ratio;
+    const size_t tick_limit = ticks / min_ratio;
+    // samples are drawn in fixed chunks with their own RNGs so scheduling doesn't affect results
+    const size_t chunk_size = 1024;
+    size_t n_chunks = (samples + chunk_size - 1) / chunk_size;
+
+    std::vector<recipe_param> c_params = params();
+    size_t n_params = c_params.size();
+    std::vector<float> widths(n_params);
+    for (size_t i = 0; i < n_params; ++i) widths[i] = dist.width(c_params[i]);
+    // ratios get perturbed as fractions of their mix
+    std::vector<float> mix_fractions = get_fractions(mix_ratios);
+    std::vector<float> primer_fractions = get_fractions(primer_ratios);
+
+    struct chunk_counts {
+        size_t successes = 0;
+        // per parameter: samples below, successes below, samples above, successes above
+        std::vector<std::array<size_t, 4>> per_param;
     };
+    std::vector<chunk_counts> counts(n_chunks);
+    pool.parallel_for(n_chunks, [&](size_t c) {
+        std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)c};
+        std::mt19937 rng(seq);
+        std::normal_distribution<float> normal_dist;
+        std::uniform_real_distribution<float> uniform_dist(-1.f, 1.f);
 
-    auto [ft_min, ft_max] = find_tolerances([](auto& c, float v){ c.fuel_temp = v; }, fuel_temp);
-    msg += std::format("  Fuel temp: {}K - {}K\n", ft_min, ft_max);
+        chunk_counts& out = counts[c];
+        out.per_param.resize(n_params);
+        std::vector<float> deltas(n_params), v_mix, v_primer;
+        size_t end = std::min(samples, (c + 1) * chunk_size);
+        for (size_t s = c * chunk_size; s < end; ++s) {
+            float v_fuel_temp = fuel_temp, v_fuel_pressure = fuel_pressure, v_thir_temp = thir_temp, v_to_pressure = to_pressure;
+            v_mix = mix_fractions;
+            v_primer = primer_fractions;
+            for (size_t i = 0; i < n_params; ++i) {
+                float d = widths[i] * (dist.uniform ? uniform_dist(rng) : normal_dist(rng));
+                deltas[i] = d;
+                switch (c_params[i].type) {
+                    case (recipe_param::fuel_temp_p): v_fuel_temp += d; break;
+                    case (recipe_param::fuel_pressure_p): v_fuel_pressure += d; break;
+                    case (recipe_param::thir_temp_p): v_thir_temp += d; break;
+                    case (recipe_param::to_pressure_p): v_to_pressure += d; break;
+                    case (recipe_param::mix_ratio_p): v_mix[c_params[i].index] += d; break;
+                    case (recipe_param::primer_ratio_p): v_primer[c_params[i].index] += d; break;
+                }
+            }
+            for (float& f : v_mix) f = std::max(0.f, f);
+            for (float& f : v_primer) f = std::max(0.f, f);
 
-    auto [fp_min, fp_max] = find_tolerances([](auto& c, float v){ c.fuel_pressure = v; }, fuel_pressure);
-    msg += std::format("  Fuel pressure: {}kPa - {}kPa\n", fp_min, fp_max);
+            gas_tank v_tank;
+            v_tank.mix.canister_fill_to(mix_gases, get_fractions(v_mix), std::max(0.f, v_fuel_temp), std::max(0.f, v_fuel_pressure));
+            v_tank.mix.canister_fill_to(primer_gases, get_fractions(v_primer), std::max(0.f, v_thir_temp), std::max(0.f, v_to_pressure));
+            size_t c_ticks = v_tank.tick_n(tick_limit);
+            bool success = v_tank.calc_radius() >= target_radius && c_ticks >= target_ticks;
 
-    auto [tt_min, tt_max] = find_tolerances([](auto& c, float v){ c.thir_temp = v; }, thir_temp);
-    msg += std::format("  Primer temp: {}K - {}K\n", tt_min, tt_max);
+            out.successes += success;
+            for (size_t i = 0; i < n_params; ++i) {
+                if (deltas[i] == 0.f) continue;
+                size_t side = deltas[i] > 0.f ? 2 : 0;
+                ++out.per_param[i][side];
+                out.per_param[i][side + 1] += success;
+            }
+        }
+    });
 
-    auto [tp_min, tp_max] = find_tolerances([](auto& c, float v){ c.to_pressure = v; }, to_pressure);
-    msg += std::format("  Release pressure: {}kPa - {}kPa\n", tp_min, tp_max);
+    robustness_report report;
+    report.samples = samples;
+    std::vector<std::array<size_t, 4>> per_param(n_params, {0, 0, 0, 0});
+    for (const chunk_counts& cc : counts) {
+        report.successes += cc.successes;
+        for (size_t i = 0; i < n_params; ++i) {
+            for (size_t j = 0; j < 4; ++j) per_param[i][j] += cc.per_param[i][j];
+        }
+    }
+    if (samples != 0) {
+        const float z = 1.96f;
+        float n = samples, p = report.success_rate();
+        float denom = 1.f + z * z / n;
+        float centre = (p + z * z / (2.f * n)) / denom;
+        float half = z * std::sqrt(p * (1.f - p) / n + z * z / (4.f * n * n)) / denom;
+        report.ci_low = std::max(0.f, centre - half);
+        report.ci_high = std::min(1.f, centre + half);
+    }
+    for (size_t i = 0; i < n_params; ++i) {
+        if (widths[i] <= 0.f) continue;
+        const std::array<size_t, 4>& pc = per_param[i];
+        report.sensitivity.push_back({c_params[i],
+                                      pc[0] == 0 ? NAN : (float)pc[1] / pc[0],
+                                      pc[2] == 0 ? NAN : (float)pc[3] / pc[2]});
+    }
+    return report;
+}
 
-    if (mix_ratios.size() > 1) {
-        float mix_sum = std::accumulate(mix_ratios.begin(), mix_ratios.end(), 0.f);
-        for (size_t i = 0; i < mix_ratios.size(); ++i) {
-            float orig_ratio = mix_ratios[i];
-            auto [min_ratio, max_ratio] = find_tolerances([i](auto& c, float v){ c.mix_ratios[i] = v; }, orig_ratio);
-            min_ratio /= mix_sum + min_ratio - orig_ratio;
-            max_ratio /= mix_sum + max_ratio - orig_ratio;
-
-            msg += std::format("  Mix {}: {}% - {}%\n", mix_gases[i].name(), min_ratio * 100.f, max_ratio * 100.f);
+std::string bomb_data::measure_robustness(size_t samples, const mismix_dist& dist, float min_ratio, size_t n_threads) const {
+    thread_pool pool(n_threads);
+    robustness_report report = robustness(samples, dist, min_ratio, pool);
+    std::string msg = std::format("  Success: {:.2f}% (95% CI {:.2f}% - {:.2f}%) over {} samples\n",
+                                  report.success_rate() * 100.f, report.ci_low * 100.f, report.ci_high * 100.f, report.samples);
+    msg += "  Success rate when below / above nominal:\n";
+    for (const robustness_report::param_sensitivity& sens : report.sensitivity) {
+        msg += std::format("    {}: {:.2f}% / {:.2f}%\n", sens.param.name(*this), sens.success_below * 100.f, sens.success_above * 100.f);
+    }
+    return msg;
+}
+
+validity_map bomb_data::map_validity(recipe_param x_param, float x_min, float x_max, size_t width,
+                                     recipe_param y_param, float y_min, float y_max, size_t height,
+                                     float min_ratio, thread_pool& pool) const {
+    for (recipe_param param : {x_param, y_param}) {
+        if ((param.type == recipe_param::mix_ratio_p && param.index >= mix_ratios.size())
+         || (param.type == recipe_param::primer_ratio_p && param.index >= primer_ratios.size())) {
+            throw std::runtime_error(std::format("recipe has no parameter {}", param.key()));
         }
     }
+    const float target_radius = fin_radius * min_ratio;
+    const float target_ticks = ticks * min_ratio;
+    const size_t tick_limit = ticks / min_ratio;
+    // axes give ratios as fractions of their mix, like tolerances(), while build_tank() takes ratios; negative if there's no such ratio
+    auto to_value = [&](recipe_param param, float value) {
+        if (param.type != recipe_param::mix_ratio_p && param.type != recipe_param::primer_ratio_p) return value;
+        if (value >= 1.f) return -1.f;
+        const std::vector<float>& ratios = param.type == recipe_param::mix_ratio_p ? mix_ratios : primer_ratios;
+        float others = std::accumulate(ratios.begin(), ratios.end(), 0.f) - ratios[param.index];
+        return value * others / (1.f - value);
+    };
 
-    if (primer_ratios.size() > 1) {
-        float primer_sum = std::accumulate(primer_ratios.begin(), primer_ratios.end(), 0.f);
-        for (size_t i = 0; i < primer_ratios.size(); ++i) {
-            float orig_ratio = primer_ratios[i];
-            auto [min_ratio, max_ratio] = find_tolerances([i](auto& c, float v){ c.primer_ratios[i] = v; }, orig_ratio);
-            min_ratio /= primer_sum + min_ratio - orig_ratio;
-            max_ratio /= primer_sum + max_ratio - orig_ratio;
-
-            msg += std::format("  Primer {}: {}% - {}%\n", primer_gases[i].name(), min_ratio * 100.f, max_ratio * 100.f);
+    size_t n_points = width * height;
+    validity_map out{x_param, y_param, x_min, x_max, y_min, y_max, width, height,
+                     std::vector<float>(n_points), std::vector<int>(n_points), std::vector<char>(n_points)};
+    // axis values once, not per point
+    std::vector<float> x_values(width), y_values(height);
+    for (size_t x = 0; x < width; ++x) x_values[x] = to_value(x_param, out.x_at(x));
+    for (size_t y = 0; y < height; ++y) y_values[y] = to_value(y_param, out.y_at(y));
+    // fixed-size chunks rather than rows, so maps with few rows still use every thread
+    const size_t chunk = 64;
+    pool.parallel_for((n_points + chunk - 1) / chunk, [&](size_t c) {
+        std::pair<recipe_param, float> changes[2] = {{x_param, 0.f}, {y_param, 0.f}};
+        for (size_t i = c * chunk; i < std::min(n_points, (c + 1) * chunk); ++i) {
+            changes[0].second = x_values[i % width];
+            changes[1].second = y_values[i / width];
+            if (changes[0].second < 0.f || changes[1].second < 0.f) continue;
+            gas_tank v_tank = build_tank(changes);
+            out.ticks[i] = v_tank.tick_n(tick_limit);
+            out.radius[i] = v_tank.calc_radius();
+            out.valid[i] = out.radius[i] >= target_radius && out.ticks[i] >= target_ticks;
         }
+    });
+    return out;
+}
+
+std::pair<float, float> bomb_data::map_range(recipe_param param, float min_ratio, thread_pool& pool) const {
+    for (const param_tolerance& tol : tolerances(min_ratio, pool)) {
+        if (tol.param.type != param.type || tol.param.index != param.index) continue;
+        bool is_ratio = param.type == recipe_param::mix_ratio_p || param.type == recipe_param::primer_ratio_p;
+        // ratio tolerances are fractions, and so is their rounding
+        float step = is_ratio ? round_ratio_to : param.round_step(*this);
+        float ext = std::max(tol.max_v - tol.min_v, step) * 0.5f;
+        return {std::max(0.f, tol.min_v - ext), is_ratio ? std::min(1.f, tol.max_v + ext) : tol.max_v + ext};
     }
+    throw std::runtime_error(std::format("recipe has no parameter {}", param.key()));
+}
 
-    return msg;
+void validity_map::write_csv(std::ostream& stream) const {
+    stream << std::format("{},{},radius,ticks,valid\n", x_param.key(), y_param.key());
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            size_t i = y * width + x;
+            stream << std::format("{},{},{},{},{}\n", x_at(x), y_at(y), radius[i], ticks[i], (int)valid[i]);
+        }
+    }
+}
+
+validity_map validity_map::read_csv(std::istream& stream) {
+    std::string line;
+    if (!std::getline(stream, line)) throw std::runtime_error("empty validity map");
+    size_t comma = line.find(',');
+    if (comma == std::string::npos) throw std::runtime_error("invalid validity map header");
+    validity_map out;
+    out.x_param = recipe_param::from_key(std::string_view(line).substr(0, comma));
+    out.y_param = recipe_param::from_key(std::string_view(line).substr(comma + 1, line.find(',', comma + 1) - comma - 1));
+
+    // rows go x first, so the width is however many rows pass before y changes
+    std::vector<float> xs, ys;
+    while (std::getline(stream, line)) {
+        if (line.empty()) continue;
+        float x, y, radius;
+        int ticks, valid;
+        if (std::sscanf(line.c_str(), "%f,%f,%f,%d,%d", &x, &y, &radius, &ticks, &valid) != 5) {
+            throw std::runtime_error(std::format("invalid validity map row: {}", line));
+        }
+        if (ys.empty() || y != ys.back()) ys.push_back(y);
+        if (ys.size() == 1) xs.push_back(x);
+        out.radius.push_back(radius);
+        out.ticks.push_back(ticks);
+        out.valid.push_back(valid != 0);
+    }
+    if (xs.empty() || out.radius.size() != xs.size() * ys.size()) throw std::runtime_error("validity map isn't a full grid");
+    out.width = xs.size();
+    out.height = ys.size();
+    out.x_min = xs.front();
+    out.x_max = xs.back();
+    out.y_min = ys.front();
+    out.y_max = ys.back();
+    return out;
 }
 
 std::string bomb_data::print_inline() const {
@@ -280,30 +779,112 @@ std::istream& operator>>(std::istream& stream, field_ref<bomb_data>& re) {
     return stream;
 }
 
-opt_val_wrap do_sim(const std::vector<float>& in_args, const bomb_args& args) {
-    // read input parameters
-    float target_temp = in_args[0];
-    float fuel_temp = in_args[1];
-    float thir_temp = in_args[2];
-    float fill_pressure = in_args[3];
-    target_temp = round_to(target_temp, args.round_temp_to);
-    fuel_temp = round_to(fuel_temp, args.round_temp_to);
-    thir_temp = round_to(thir_temp, args.round_temp_to);
-    // only round fill pressure if it's not too close to pressure cap
-    if (std::abs(fill_pressure - pressure_cap) > args.round_pressure_to * 2.f) {
-        fill_pressure = std::min(pressure_cap, round_to(fill_pressure, args.round_pressure_to));
+std::string field_name(const field_ref<bomb_data>& field) {
+    auto same = [&](const field_ref<bomb_data>& other) { return field.offset == other.offset && field.type == other.type; };
+    if (same(bomb_data::radius_field)) return "radius";
+    if (same(bomb_data::ticks_field)) return "ticks";
+    if (same(bomb_data::temperature_field)) return "temperature";
+    if (same(bomb_data::integrity_field)) return "integrity";
+    for (const auto& [gas, gas_field] : bomb_data::gas_fields) {
+        if (same(gas_field)) return std::string(gas.name());
     }
-    // invalid mix, abort early
-    if ((target_temp > fuel_temp) == (target_temp > thir_temp)) {
-        return {};
+    throw std::runtime_error("field reference has no name");
+}
+
+// rates a simulated bomb by the robust_args quantile of its outcomes over the mismixing stencil
+// returns false if that quantile fails restrictions
+static bool rate_robust(bomb_data& bomb, const bomb_args& args, const robust_args& robust) {
+    // rates below anything a bomb can get, finite so it survives -ffast-math
+    constexpr float fail_rating = std::numeric_limits<float>::lowest();
+    float sign = robust.maximise ? 1.f : -1.f;
+
+    std::vector<float> ratings = {sign * bomb.optstat};
+    // restrictions and optstat only look at the tank and simulation results, so one copy serves every stencil point
+    bomb_data variant = bomb;
+    for (const recipe_param& param : bomb.params()) {
+        float delta;
+        switch (param.type) {
+            case (recipe_param::fuel_temp_p): case (recipe_param::thir_temp_p): delta = robust.temp_delta; break;
+            case (recipe_param::fuel_pressure_p): case (recipe_param::to_pressure_p): delta = robust.pressure_delta; break;
+            default: delta = robust.ratio_delta; break;
+        }
+        if (delta <= 0.f) continue;
+        float nominal = param.of(bomb);
+        for (float value : {nominal - delta, nominal + delta}) {
+            if (value < 0.f) continue;
+            std::pair<recipe_param, float> change{param, value};
+            variant.tank = bomb.build_tank({&change, 1});
+            bool pre_met = std::none_of(args.pre_restrictions.begin(), args.pre_restrictions.end(), [&variant](const auto& r){ return !r.OK(variant); });
+            variant.sim_ticks(args.tick_cap, args.opt_param, args.measure_before);
+            bool post_met = std::none_of(args.post_restrictions.begin(), args.post_restrictions.end(), [&variant](const auto& r){ return !r.OK(variant); });
+            ratings.push_back(pre_met && post_met ? sign * variant.optstat : fail_rating);
+        }
+    }
+
+    // 0th is the worst
+    size_t idx = (size_t)(robust.quantile * (ratings.size() - 1));
+    std::nth_element(ratings.begin(), ratings.begin() + idx, ratings.end());
+    float rating = ratings[idx];
+    if (rating == fail_rating) return false;
+    bomb.optstat = sign * rating;
+
+    float best = robust.best_rating.load(std::memory_order_relaxed);
+    while (rating > best && !robust.best_rating.compare_exchange_weak(best, rating, std::memory_order_relaxed));
+    return true;
+}
+
+screen_args::screen_args(std::vector<size_t> horizons, float keep_fraction)
+    : horizons(horizons), keep_fraction(keep_fraction), stages(std::make_unique<stage_state[]>(horizons.size())) {
+
+    std::sort(this->horizons.begin(), this->horizons.end());
+}
+
+bool screen_args::promote(size_t stage, float score) const {
+    // how many recent scores the threshold is taken from, and how often it's updated
+    const size_t window = 1024, update_spacing = 32;
+
+    if (keep_fraction >= 1.f) return true;
+    stage_state& state = stages[stage];
+    bool pass = score >= state.threshold.load(std::memory_order_relaxed);
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.recent.size() < window) {
+            state.recent.push_back(score);
+        } else {
+            state.recent[state.seen % window] = score;
+        }
+        ++state.seen;
+        // first right after warmup, then every update_spacing
+        size_t first_update = std::max(warmup, (size_t)1);
+        if (state.seen >= first_update && (state.seen - first_update) % update_spacing == 0) {
+            std::vector<float> sorted = state.recent;
+            size_t keep_idx = std::min(sorted.size() - 1, (size_t)(sorted.size() * (1.f - keep_fraction)));
+            std::nth_element(sorted.begin(), sorted.begin() + keep_idx, sorted.end());
+            state.threshold.store(sorted[keep_idx], std::memory_order_relaxed);
+        }
+    }
+    if (!pass) discarded_count.fetch_add(1, std::memory_order_relaxed);
+    return pass;
+}
+
+// what do_sim gets out of its args before target temperature comes in
+struct prepared_mix {
+    float fuel_temp, thir_temp, fill_pressure;
+    std::vector<float> mix_fractions, primer_fractions;
+    float fuel_specheat, primer_specheat;
+};
+
+static prepared_mix prepare_mix(const std::vector<float>& in_args, const bomb_args& args) {
+    prepared_mix mix;
+    mix.fuel_temp = round_to(in_args[1], args.round_temp_to);
+    mix.thir_temp = round_to(in_args[2], args.round_temp_to);
+    mix.fill_pressure = in_args[3];
+    // only round fill pressure if it's not too close to pressure cap
+    if (std::abs(mix.fill_pressure - pressure_cap) > args.round_pressure_to * 2.f) {
+        mix.fill_pressure = std::min(pressure_cap, round_to(mix.fill_pressure, args.round_pressure_to));
     }
     const std::vector<gas_ref>& mix_gases = args.mix_gases;
     const std::vector<gas_ref>& primer_gases = args.primer_gases;
-    bool measure_before = args.measure_before;
-    size_t tick_cap = args.tick_cap;
-    field_ref<bomb_data> optstat_ref = args.opt_param;
-    const std::vector<field_restriction<bomb_data>>& pre_restrictions = args.pre_restrictions;
-    const std::vector<field_restriction<bomb_data>>& post_restrictions = args.post_restrictions;
 
     // read gas ratios
     std::vector<float> mix_ratios(mix_gases.size(), 1.f);
@@ -317,42 +898,235 @@ opt_val_wrap do_sim(const std::vector<float>& in_args, const bomb_args& args) {
         primer_ratios[i + 1] = std::exp(in_args[4 + mg_s + i]);
     }
 
-    std::vector<float> mix_fractions = get_fractions(mix_ratios);
-    for (float& f : mix_fractions) f = round_to(f, args.round_ratio_to);
-    mix_fractions *= 1.f / std::accumulate(mix_fractions.begin(), mix_fractions.end(), 0.f);
-    std::vector<float> primer_fractions = get_fractions(primer_ratios);
-    for (float& f : primer_fractions) f = round_to(f, args.round_ratio_to);
-    primer_fractions *= 1.f / std::accumulate(primer_fractions.begin(), primer_fractions.end(), 0.f);
+    mix.mix_fractions = get_fractions(mix_ratios);
+    for (float& f : mix.mix_fractions) f = round_to(f, args.round_ratio_to);
+    mix.mix_fractions *= 1.f / std::accumulate(mix.mix_fractions.begin(), mix.mix_fractions.end(), 0.f);
+    mix.primer_fractions = get_fractions(primer_ratios);
+    for (float& f : mix.primer_fractions) f = round_to(f, args.round_ratio_to);
+    mix.primer_fractions *= 1.f / std::accumulate(mix.primer_fractions.begin(), mix.primer_fractions.end(), 0.f);
+
+    // specific heat is heat capacity of 1mol and fractions sum up to 1mol
+    mix.fuel_specheat = get_mix_heat_capacity(mix_gases, mix.mix_fractions);
+    mix.primer_specheat = get_mix_heat_capacity(primer_gases, mix.primer_fractions);
+    return mix;
+}
+
+// full also applies screening and robustness rating, otherwise only restrictions decide validity
+static opt_val_wrap sim_target(const prepared_mix& mix, float target_temp, const bomb_args& args, bool full) {
+    float fuel_temp = mix.fuel_temp;
+    float thir_temp = mix.thir_temp;
+    float fill_pressure = mix.fill_pressure;
+    // invalid mix, abort early
+    if ((target_temp > fuel_temp) == (target_temp > thir_temp)) {
+        return {};
+    }
+    const std::vector<gas_ref>& mix_gases = args.mix_gases;
+    const std::vector<gas_ref>& primer_gases = args.primer_gases;
+    bool measure_before = args.measure_before;
+    size_t tick_cap = args.tick_cap;
+    field_ref<bomb_data> optstat_ref = args.opt_param;
+    const std::vector<field_restriction<bomb_data>>& pre_restrictions = args.pre_restrictions;
+    const std::vector<field_restriction<bomb_data>>& post_restrictions = args.post_restrictions;
 
     // set up the tank
     gas_tank mix_tank;
 
-    // specific heat is heat capacity of 1mol and fractions sum up to 1mol
-    float fuel_specheat = get_mix_heat_capacity(mix_gases, mix_fractions);
-    float primer_specheat = get_mix_heat_capacity(primer_gases, primer_fractions);
+    float fuel_specheat = mix.fuel_specheat;
+    float primer_specheat = mix.primer_specheat;
     // to how much we want to fill the tank
     float fuel_pressure = (target_temp / thir_temp - 1.f) * fill_pressure / (fuel_specheat / primer_specheat - 1.f + target_temp * (1.f / thir_temp - fuel_specheat / primer_specheat / fuel_temp));
     fuel_pressure = round_to(fuel_pressure, args.round_pressure_to);
-    mix_tank.mix.canister_fill_to(mix_gases, mix_fractions, fuel_temp, fuel_pressure);
-    mix_tank.mix.canister_fill_to(primer_gases, primer_fractions, thir_temp, fill_pressure);
 
     // invalid mix, abort
     if (fuel_pressure > fill_pressure || fuel_pressure < 0.0) {
         return {};
     }
+    mix_tank.mix.canister_fill_to(mix_gases, mix.mix_fractions, fuel_temp, fuel_pressure);
+    mix_tank.mix.canister_fill_to(primer_gases, mix.primer_fractions, thir_temp, fill_pressure);
 
-    std::shared_ptr<bomb_data> bomb = std::make_shared<bomb_data>(mix_fractions, primer_fractions, fill_pressure,
+    std::shared_ptr<bomb_data> bomb = std::make_shared<bomb_data>(mix.mix_fractions, mix.primer_fractions, fill_pressure,
                    fuel_temp, fuel_pressure, thir_temp, target_temp,
                    mix_gases, primer_gases,
                    std::move(mix_tank), args.round_pressure_to, args.round_temp_to, args.round_ratio_to);
 
     bool pre_met = std::none_of(pre_restrictions.begin(), pre_restrictions.end(), [&bomb](const auto& r){ return !r.OK(*bomb); });
 
-    // simulate for up to tick_cap ticks
-    bomb->sim_ticks(tick_cap, optstat_ref, measure_before);
+    // simulate for up to tick_cap ticks, unless screening decides it's not worth it
+    const screen_args* screen = full && args.screen && args.screen->enabled() ? args.screen : nullptr;
+    if (!bomb->sim_ticks(tick_cap, optstat_ref, measure_before, screen)) {
+        // not invalid, just not worth finishing
+        opt_val_wrap res(bomb, true);
+        res.pruned_v = true;
+        return res;
+    }
 
     bool post_met = std::none_of(post_restrictions.begin(), post_restrictions.end(), [&bomb](const auto& r){ return !r.OK(*bomb); });
+    const robust_args* robust = args.robust;
+    if (full && pre_met && post_met && robust && robust->enabled()) {
+        // the nominal outcome is part of the stencil, so the worst case can't rate better than it
+        // if it's already worse than the best robust rating, don't bother simulating the stencil
+        // for quantiles above 0 this is only a heuristic
+        float sign = robust->maximise ? 1.f : -1.f;
+        if (sign * bomb->optstat < robust->best_rating.load(std::memory_order_relaxed)) {
+            opt_val_wrap res(bomb, true);
+            res.pruned_v = true;
+            return res;
+        }
+        return opt_val_wrap(bomb, rate_robust(*bomb, args, *robust));
+    }
     return opt_val_wrap(bomb, pre_met && post_met);
 }
 
+// scan and golden-section search over target temperature grid points, each simulated at most once
+static opt_val_wrap solve_target(const prepared_mix& mix, const bomb_args& args, const target_solve_args& solve) {
+    float step = args.round_temp_to > 0.f ? args.round_temp_to : solve.resolution;
+    // only temperatures between the fuel and primer temps make a valid mix
+    float lower = std::max(solve.lower, std::min(mix.fuel_temp, mix.thir_temp));
+    float upper = std::min(solve.upper, std::max(mix.fuel_temp, mix.thir_temp));
+    long lo = (long)std::ceil(lower / step), hi = (long)std::floor(upper / step);
+    if (hi < lo) return {};
+
+    float sign = solve.maximise ? 1.f : -1.f;
+    std::vector<std::pair<long, opt_val_wrap>> tried;
+    long best_at = lo;
+    opt_val_wrap best;
+    auto eval = [&](long at) -> const opt_val_wrap& {
+        for (const auto& [t, res] : tried) {
+            if (t == at) return res;
+        }
+        opt_val_wrap res = sim_target(mix, at * step, args, false);
+        if (res.valid() && (!best.valid() || sign * res.rating() > sign * best.rating())) {
+            best = res;
+            best_at = at;
+        }
+        return tried.emplace_back(at, std::move(res)).second;
+    };
+    // invalid points rate below anything valid
+    auto rate = [&](long at) {
+        const opt_val_wrap& res = eval(at);
+        return res.valid() ? sign * res.rating() : std::numeric_limits<float>::lowest();
+    };
+
+    // the lower end is what we'd get without solving, so it's always tried
+    long scan_best = lo;
+    size_t points = std::max(solve.scan_points, (size_t)2);
+    long spacing = (hi - lo + (long)points - 2) / ((long)points - 1);
+    for (size_t i = 1; i < points; ++i) {
+        long at = lo + (long)std::round((double)(hi - lo) * i / (points - 1));
+        if (rate(at) > rate(scan_best)) scan_best = at;
+    }
+    lo = std::max(lo, scan_best - spacing);
+    hi = std::min(hi, scan_best + spacing);
+
+    const float inv_phi = 0.618034f;
+    while (hi - lo > 3) {
+        long span = (long)std::round((hi - lo) * inv_phi);
+        long m1 = hi - span, m2 = lo + span;
+        if (m1 >= m2) m2 = m1 + 1;
+        if (rate(m1) >= rate(m2)) {
+            hi = m2 - 1;
+        } else {
+            lo = m1 + 1;
+        }
+    }
+    for (long at = lo; at <= hi; ++at) eval(at);
+
+    // screening and robustness only for the one we keep
+    if (!best.valid()) return {};
+    bool needs_full = (args.screen && args.screen->enabled()) || (args.robust && args.robust->enabled());
+    return needs_full ? sim_target(mix, best_at * step, args, true) : best;
+}
+
+opt_val_wrap do_sim(const std::vector<float>& in_args, const bomb_args& args) {
+    prepared_mix mix = prepare_mix(in_args, args);
+    if (args.solve_target && args.solve_target->enabled()) {
+        return solve_target(mix, args, *args.solve_target);
+    }
+    return sim_target(mix, round_to(in_args[0], args.round_temp_to), args, true);
+}
+
+// log-ratios of each gas to the first, as do_sim takes them
+static void append_log_ratios(std::vector<float>& out, const std::vector<gas_ref>& gases,
+                              const std::vector<gas_ref>& recipe_gases, const std::vector<float>& recipe_fractions) {
+    // log of 0 would be infinite, this is well below what rounding keeps anyway
+    constexpr float min_fraction = 1e-6f;
+    auto fraction_of = [&](gas_ref gas) {
+        auto it = std::find(recipe_gases.begin(), recipe_gases.end(), gas);
+        return std::max(min_fraction, it == recipe_gases.end() ? 0.f : recipe_fractions[it - recipe_gases.begin()]);
+    };
+    float first = fraction_of(gases[0]);
+    for (size_t i = 1; i < gases.size(); ++i) {
+        out.push_back(std::log(fraction_of(gases[i]) / first));
+    }
+}
+
+std::vector<float> recipe_args(const bomb_data& recipe, const std::vector<gas_ref>& mix_gases, const std::vector<gas_ref>& primer_gases) {
+    std::vector<float> out = {recipe.mix_to_temp, recipe.fuel_temp, recipe.thir_temp, recipe.to_pressure};
+    append_log_ratios(out, mix_gases, recipe.mix_gases, recipe.mix_ratios);
+    append_log_ratios(out, primer_gases, recipe.primer_gases, recipe.primer_ratios);
+    return out;
+}
+
+// ratio_lattice() progress, in whole rounding steps
+struct ratio_lattice_state {
+    // per gas after the first, the steps it may take given the first gas' steps
+    std::vector<long> lo, hi;
+    std::vector<long> steps;
+};
+
+// steps of gases [i, end) for ratio_lattice() given the ones before, calling emit on each complete split until it returns false
+static bool fill_ratio_lattice(ratio_lattice_state& state, size_t i, long left, const std::function<bool()>& emit) {
+    size_t n_gases = state.steps.size();
+    // the gases after us have to be able to take what's left
+    long rest_lo = 0, rest_hi = 0;
+    for (size_t j = i + 1; j < n_gases; ++j) {
+        rest_lo += state.lo[j - 1];
+        rest_hi += state.hi[j - 1];
+    }
+    long from = std::max(state.lo[i - 1], left - rest_hi), to = std::min(state.hi[i - 1], left - rest_lo);
+    for (long n = from; n <= to; ++n) {
+        state.steps[i] = n;
+        bool more = i + 1 == n_gases ? emit() : fill_ratio_lattice(state, i + 1, left - n, emit);
+        if (!more) return false;
+    }
+    return true;
+}
+
+std::vector<std::vector<float>> ratio_lattice(const std::vector<float>& ratio_lower, const std::vector<float>& ratio_upper,
+                                              float round_ratio_to, size_t max_points) {
+    size_t n_ratios = ratio_lower.size();
+    std::vector<std::vector<float>> points;
+    if (n_ratios == 0) {
+        points.emplace_back();
+        return points;
+    }
+    if (round_ratio_to <= 0.f) {
+        throw std::runtime_error("a ratio lattice needs ratio rounding above 0");
+    }
+    long total = std::lround(1.f / round_ratio_to);
+
+    ratio_lattice_state state;
+    state.lo.resize(n_ratios);
+    state.hi.resize(n_ratios);
+    state.steps.resize(n_ratios + 1);
+    auto emit = [&] {
+        std::vector<float> point(n_ratios);
+        for (size_t i = 0; i < n_ratios; ++i) {
+            point[i] = std::clamp(std::log((float)state.steps[i + 1] / state.steps[0]), ratio_lower[i], ratio_upper[i]);
+        }
+        points.push_back(std::move(point));
+        return points.size() <= max_points;
+    };
+    for (long first = 1; first < total; ++first) {
+        state.steps[0] = first;
+        // every gas gets at least a step so ratios stay finite, with half a step of slack so rounding at the bounds still counts
+        for (size_t i = 0; i < n_ratios; ++i) {
+            state.lo[i] = std::max(1l, (long)std::ceil(first * std::exp(ratio_lower[i]) - 0.5));
+            state.hi[i] = (long)std::floor(first * std::exp(ratio_upper[i]) + 0.5);
+        }
+        if (!fill_ratio_lattice(state, 1, total - first, emit)) break;
+    }
+    return points;
+}
+
 }
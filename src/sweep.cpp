@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <memory>
+#include <stdexcept>
+
+#include "optimiser.hpp"
+#include "sweep.hpp"
+
+namespace asim {
+
+// owns the gas lists its optimiser's args refer to, so must not move
+struct sweep_candidate {
+    sweep_result result;
+    std::unique_ptr<optimiser<bomb_args, opt_val_wrap>> optim;
+};
+
+static std::vector<gas_ref> pick_gases(const std::vector<gas_ref>& gases, unsigned mask) {
+    std::vector<gas_ref> out;
+    for (size_t i = 0; i < gases.size(); ++i) {
+        if (mask & (1u << i)) out.push_back(gases[i]);
+    }
+    return out;
+}
+
+std::vector<sweep_result> sweep_gases(const sweep_options& opts, thread_pool& pool) {
+    if (opts.gases.empty() || opts.gases.size() > gas_count) {
+        throw std::runtime_error(std::format("gas sweep needs between 1 and {} gases", gas_count));
+    }
+    if (opts.lower_bounds.size() != 4 || opts.upper_bounds.size() != 4) {
+        throw std::runtime_error("gas sweep needs bounds for target temp, fuel temp, thir temp and pressure");
+    }
+
+    std::vector<std::unique_ptr<sweep_candidate>> candidates;
+    unsigned n_masks = 1u << opts.gases.size();
+    for (unsigned mix = 1; mix < n_masks; ++mix) {
+        size_t mix_size = std::popcount(mix);
+        if (mix_size > opts.max_mix_gases) continue;
+        for (unsigned primer = 1; primer < n_masks; ++primer) {
+            size_t primer_size = std::popcount(primer);
+            if ((primer & mix) || primer_size > opts.max_primer_gases || mix_size + primer_size > recipe_record::max_gases) continue;
+
+            auto cand = std::make_unique<sweep_candidate>();
+            cand->result.mix_gases = pick_gases(opts.gases, mix);
+            cand->result.primer_gases = pick_gases(opts.gases, primer);
+            size_t num_ratios = mix_size - 1 + primer_size - 1;
+            std::vector<float> lower_bounds(opts.lower_bounds), upper_bounds(opts.upper_bounds);
+            lower_bounds.resize(4 + num_ratios, -opts.ratio_bound);
+            upper_bounds.resize(4 + num_ratios, opts.ratio_bound);
+            cand->optim = std::make_unique<optimiser<bomb_args, opt_val_wrap>>(
+                do_sim,
+                lower_bounds,
+                upper_bounds,
+                opts.maximise,
+                bomb_args{cand->result.mix_gases, cand->result.primer_gases, opts.measure_before,
+                          opts.round_pressure_to, opts.round_temp_to, opts.round_ratio_to,
+                          opts.tick_cap, opts.opt_param, opts.pre_restrictions, opts.post_restrictions},
+                duration_t(0),
+                opts.sample_rounds,
+                opts.bounds_scale,
+                LOG_NONE);
+            candidates.push_back(std::move(cand));
+        }
+    }
+    if (candidates.empty()) {
+        throw std::runtime_error("no gas combinations fit the given sizes");
+    }
+
+    // every rung costs the same total time, half the candidates for twice as long each
+    size_t n_rungs = 1;
+    for (size_t left = candidates.size(); left > 1; left = (left + 1) / 2) ++n_rungs;
+    float seconds = opts.total_seconds * pool.size() / (n_rungs * candidates.size());
+    log([&]{ return std::format("Sweeping {} combinations over {} rungs, starting at {}s each", candidates.size(), n_rungs, seconds); }, opts.log_level, LOG_BASIC);
+
+    std::vector<sweep_candidate*> alive;
+    for (auto& cand : candidates) alive.push_back(cand.get());
+
+    auto better = [&](const sweep_candidate* lhs, const sweep_candidate* rhs) {
+        return optimiser<bomb_args, opt_val_wrap>::better_than(lhs->result.best, rhs->result.best, opts.maximise);
+    };
+
+    for (size_t rung = 0; rung < n_rungs && !status_SIGINT; ++rung) {
+        // candidates keep their best between rungs, so each run continues where the last left off
+        pool.parallel_for(alive.size(), [&](size_t i) {
+            sweep_candidate& cand = *alive[i];
+            cand.optim->max_duration = as_seconds(seconds);
+            cand.optim->find_best();
+            cand.result.best = cand.optim->best_result;
+            cand.result.seconds += seconds;
+            cand.result.rungs = rung + 1;
+        });
+        std::stable_sort(alive.begin(), alive.end(), better);
+        log([&]{ return std::format("Rung {}: {} combinations at {}s each, best: {}", rung + 1, alive.size(), seconds, alive[0]->result.best.rating_str()); }, opts.log_level, LOG_BASIC);
+        alive.resize((alive.size() + 1) / 2);
+        seconds *= 2.f;
+    }
+
+    std::vector<sweep_result> results;
+    for (auto& cand : candidates) results.push_back(std::move(cand->result));
+    std::stable_sort(results.begin(), results.end(), [&](const sweep_result& lhs, const sweep_result& rhs) {
+        if (lhs.rungs != rhs.rungs) return lhs.rungs > rhs.rungs;
+        return optimiser<bomb_args, opt_val_wrap>::better_than(lhs.best, rhs.best, opts.maximise);
+    });
+    return results;
+}
+
+}
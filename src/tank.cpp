@@ -51,10 +51,17 @@ bool gas_tank::tick() {
 }
 
 size_t gas_tank::tick_n(size_t ticks_limit) {
+    bool stopped;
+    return tick_n(ticks_limit, stopped);
+}
+
+size_t gas_tank::tick_n(size_t ticks_limit, bool& stopped) {
+    stopped = true;
     for (size_t i = 0; i < ticks_limit; ++i) {
         // early exit if we ruptured or if we're inert
         if (!tick() || state != gas_tank::st_intact) return i + 1;
     }
+    stopped = false;
     return ticks_limit;
 }
 
@@ -63,4 +70,13 @@ std::string gas_tank::get_status() {
                         mix.pressure(), mix.temperature, integrity, mix.to_string());
 }
 
+const char* gas_tank::state_name() const {
+    switch (state) {
+        case (st_intact): return "intact";
+        case (st_ruptured): return "ruptured";
+        case (st_exploded): return "exploded";
+    }
+    return "unknown";
+}
+
 }
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "thread_pool.hpp"
+
+namespace asim {
+
+thread_pool::thread_pool(size_t n_threads) {
+    for (size_t i = 1; i < n_threads; ++i) {
+        workers.emplace_back([this] {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(queue_mutex);
+                    queue_cv.wait(lock, [this]{ return stopping || !queue.empty(); });
+                    if (queue.empty()) return;
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+                task();
+            }
+        });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard lock(queue_mutex);
+        queue.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+}
+
+void thread_pool::parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+
+    // shared with helpers, which may only get to run after we've returned
+    struct for_state {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::exception_ptr error = nullptr;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    std::shared_ptr<for_state> state = std::make_shared<for_state>();
+
+    auto run = [state, n, &fn] {
+        size_t finished = 0;
+        for (size_t i = state->next++; i < n; i = state->next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard lock(state->mutex);
+                if (!state->error) state->error = std::current_exception();
+            }
+            ++finished;
+        }
+        if (finished == 0) return;
+        std::lock_guard lock(state->mutex);
+        state->done += finished;
+        if (state->done == n) state->cv.notify_all();
+    };
+
+    size_t helpers = std::min(n - 1, workers.size());
+    if (helpers != 0) {
+        {
+            std::lock_guard lock(queue_mutex);
+            // helpers that start after everything is claimed exit without touching fn
+            for (size_t i = 0; i < helpers; ++i) queue.push_back(run);
+        }
+        queue_cv.notify_all();
+    }
+    run();
+
+    std::unique_lock lock(state->mutex);
+    state->cv.wait(lock, [&]{ return state->done == n; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+}
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <random>
+#include <stdexcept>
 #include <vector>
 
 #include "utility.hpp"
@@ -40,6 +45,238 @@ std::string str_round_to(float what, float to) {
     return std::format("{:.{}f}", rounded, digits);
 }
 
+std::string json_string(std::string_view str) {
+    std::string out = "\"";
+    for (char c : str) {
+        switch (c) {
+            case ('"'): out += "\\\""; break;
+            case ('\\'): out += "\\\\"; break;
+            case ('\n'): out += "\\n"; break;
+            case ('\r'): out += "\\r"; break;
+            case ('\t'): out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) out += std::format("\\u{:04x}", (int)c);
+                else out += c;
+        }
+    }
+    return out + "\"";
+}
+
+bool is_finite(float num) {
+    // all exponent bits set is infinity or NaN
+    return (std::bit_cast<uint32_t>(num) & 0x7f800000u) != 0x7f800000u;
+}
+
+std::string json_number(float num) {
+    return is_finite(num) ? std::format("{}", num) : "null";
+}
+
+std::string json_object::scalar::json() const {
+    return is_string ? json_string(text) : text;
+}
+
+bool json_object::has(std::string_view key) const {
+    return values.find(key) != values.end() || arrays.find(key) != arrays.end();
+}
+
+static const json_object::scalar* find_scalar(const json_object& obj, std::string_view key) {
+    auto it = obj.values.find(key);
+    if (it != obj.values.end()) return &it->second;
+    if (obj.arrays.find(key) != obj.arrays.end()) throw std::runtime_error(std::format("expected a single value for {}", key));
+    return nullptr;
+}
+
+static double scalar_number(const json_object::scalar& val, std::string_view key) {
+    double out;
+    const std::string& text = val.text;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    if (val.is_string || ec != std::errc() || ptr != text.data() + text.size()) {
+        throw std::runtime_error(std::format("expected a number for {}", key));
+    }
+    return out;
+}
+
+std::string json_object::get_string(std::string_view key, std::string_view def) const {
+    const scalar* val = find_scalar(*this, key);
+    if (!val) return std::string(def);
+    if (!val->is_string) throw std::runtime_error(std::format("expected a string for {}", key));
+    return val->text;
+}
+
+float json_object::get_float(std::string_view key, float def) const {
+    const scalar* val = find_scalar(*this, key);
+    return val ? scalar_number(*val, key) : def;
+}
+
+size_t json_object::get_size(std::string_view key, size_t def) const {
+    const scalar* val = find_scalar(*this, key);
+    if (!val) return def;
+    double num = scalar_number(*val, key);
+    if (num < 0.0 || num != std::floor(num)) throw std::runtime_error(std::format("expected a non-negative integer for {}", key));
+    return (size_t)num;
+}
+
+bool json_object::get_bool(std::string_view key, bool def) const {
+    const scalar* val = find_scalar(*this, key);
+    if (!val) return def;
+    if (val->is_string || (val->text != "true" && val->text != "false")) throw std::runtime_error(std::format("expected true or false for {}", key));
+    return val->text == "true";
+}
+
+std::vector<std::string> json_object::get_strings(std::string_view key) const {
+    std::vector<std::string> out;
+    auto it = arrays.find(key);
+    if (it == arrays.end()) {
+        if (values.find(key) != values.end()) throw std::runtime_error(std::format("expected an array for {}", key));
+        return out;
+    }
+    for (const scalar& val : it->second) {
+        if (!val.is_string) throw std::runtime_error(std::format("expected strings in {}", key));
+        out.push_back(val.text);
+    }
+    return out;
+}
+
+std::vector<float> json_object::get_floats(std::string_view key) const {
+    std::vector<float> out;
+    auto it = arrays.find(key);
+    if (it == arrays.end()) {
+        if (values.find(key) != values.end()) throw std::runtime_error(std::format("expected an array for {}", key));
+        return out;
+    }
+    for (const scalar& val : it->second) out.push_back(scalar_number(val, key));
+    return out;
+}
+
+json_object json_object::parse(std::string_view str) {
+    size_t pos = 0;
+    auto fail = [&](std::string_view what) {
+        throw std::runtime_error(std::format("invalid JSON at {}: {}", pos, what));
+    };
+    auto skip_ws = [&]() {
+        while (pos < str.size() && (str[pos] == ' ' || str[pos] == '\t' || str[pos] == '\n' || str[pos] == '\r')) ++pos;
+    };
+    auto expect = [&](char c) {
+        skip_ws();
+        if (pos >= str.size() || str[pos] != c) fail(std::format("expected '{}'", c));
+        ++pos;
+    };
+    auto append_utf8 = [](std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xc0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            out += (char)(0xe0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3f));
+            out += (char)(0x80 | (cp & 0x3f));
+        } else {
+            out += (char)(0xf0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3f));
+            out += (char)(0x80 | ((cp >> 6) & 0x3f));
+            out += (char)(0x80 | (cp & 0x3f));
+        }
+    };
+    auto parse_hex4 = [&]() -> uint32_t {
+        uint32_t cp = 0;
+        if (pos + 4 > str.size()) fail("truncated escape");
+        auto [ptr, ec] = std::from_chars(str.data() + pos, str.data() + pos + 4, cp, 16);
+        if (ec != std::errc() || ptr != str.data() + pos + 4) fail("bad unicode escape");
+        pos += 4;
+        return cp;
+    };
+    auto parse_string = [&]() -> std::string {
+        expect('"');
+        std::string out;
+        while (true) {
+            if (pos >= str.size()) fail("unterminated string");
+            char c = str[pos++];
+            if (c == '"') return out;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= str.size()) fail("unterminated string");
+            switch (str[pos++]) {
+                case ('"'): out += '"'; break;
+                case ('\\'): out += '\\'; break;
+                case ('/'): out += '/'; break;
+                case ('b'): out += '\b'; break;
+                case ('f'): out += '\f'; break;
+                case ('n'): out += '\n'; break;
+                case ('r'): out += '\r'; break;
+                case ('t'): out += '\t'; break;
+                case ('u'): {
+                    uint32_t cp = parse_hex4();
+                    // surrogate pair
+                    if (cp >= 0xd800 && cp < 0xdc00 && str.substr(pos, 2) == "\\u") {
+                        pos += 2;
+                        uint32_t low = parse_hex4();
+                        if (low < 0xdc00 || low >= 0xe000) fail("bad surrogate pair");
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default: fail("bad escape");
+            }
+        }
+    };
+    auto parse_scalar = [&]() -> scalar {
+        skip_ws();
+        if (pos >= str.size()) fail("expected a value");
+        if (str[pos] == '"') return {parse_string(), true};
+        if (str[pos] == '{' || str[pos] == '[') fail("nested values aren't supported");
+        size_t start = pos;
+        while (pos < str.size() && std::string_view(",]} \t\r\n").find(str[pos]) == std::string_view::npos) ++pos;
+        if (pos == start) fail("expected a value");
+        return {std::string(str.substr(start, pos - start)), false};
+    };
+
+    json_object out;
+    expect('{');
+    skip_ws();
+    if (pos < str.size() && str[pos] == '}') {
+        ++pos;
+    } else {
+        while (true) {
+            std::string key = parse_string();
+            expect(':');
+            skip_ws();
+            if (pos < str.size() && str[pos] == '[') {
+                ++pos;
+                std::vector<scalar>& arr = out.arrays[key];
+                skip_ws();
+                if (pos < str.size() && str[pos] == ']') {
+                    ++pos;
+                } else {
+                    while (true) {
+                        arr.push_back(parse_scalar());
+                        skip_ws();
+                        if (pos < str.size() && str[pos] == ']') {
+                            ++pos;
+                            break;
+                        }
+                        expect(',');
+                    }
+                }
+            } else {
+                out.values[key] = parse_scalar();
+            }
+            skip_ws();
+            if (pos < str.size() && str[pos] == '}') {
+                ++pos;
+                break;
+            }
+            expect(',');
+        }
+    }
+    skip_ws();
+    if (pos != str.size()) fail("trailing characters");
+    return out;
+}
+
 std::vector<float>& operator+=(std::vector<float>& lhs, const std::vector<float>& rhs) {
     size_t dims = lhs.size();
     for (size_t i = 0; i < dims; ++i) {
@@ -221,6 +458,125 @@ void space_vectors(std::vector<std::vector<float>>& vecs, float strength) {
     }
 }
 
+// new-joe-kuo-6.21201: {degree, polynomial coefficients, initial direction numbers}, dimension 0 is implicit
+struct sobol_poly {
+    uint32_t s, a;
+    uint32_t m[8];
+};
+static const sobol_poly sobol_polys[] = {
+    {1, 0,  {1}},
+    {2, 1,  {1, 3}},
+    {3, 1,  {1, 3, 1}},
+    {3, 2,  {1, 1, 1}},
+    {4, 1,  {1, 1, 3, 3}},
+    {4, 4,  {1, 3, 5, 13}},
+    {5, 2,  {1, 1, 5, 5, 17}},
+    {5, 4,  {1, 1, 5, 5, 5}},
+    {5, 7,  {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1,  {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1,  {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4,  {1, 3, 7, 13, 13, 15, 69}},
+    {7, 7,  {1, 1, 3, 13, 7, 35, 63}},
+    {7, 8,  {1, 3, 5, 9, 1, 25, 53}},
+    {7, 14, {1, 3, 1, 13, 9, 35, 107}}
+};
+
+const size_t sobol_sequence::max_dims = std::size(sobol_polys) + 1;
+
+sobol_sequence::sobol_sequence(size_t dims, uint64_t seed): dims(dims), directions(dims * 32), shift(dims) {
+    if (dims > max_dims) {
+        throw std::runtime_error(std::format("sobol sequence supports at most {} dimensions, got {}", max_dims, dims));
+    }
+    for (size_t j = 0; j < 32; ++j) {
+        directions[j] = 1u << (31 - j);
+    }
+    for (size_t d = 1; d < dims; ++d) {
+        const sobol_poly& poly = sobol_polys[d - 1];
+        uint32_t* v = &directions[d * 32];
+        for (size_t j = 0; j < 32; ++j) {
+            if (j < poly.s) {
+                v[j] = poly.m[j] << (31 - j);
+                continue;
+            }
+            v[j] = v[j - poly.s] ^ (v[j - poly.s] >> poly.s);
+            for (size_t k = 1; k < poly.s; ++k) {
+                v[j] ^= ((poly.a >> (poly.s - 1 - k)) & 1u) * v[j - k];
+            }
+        }
+    }
+    std::mt19937_64 gen(seed);
+    for (uint32_t& sh : shift) sh = (uint32_t)gen();
+}
+
+std::vector<float> sobol_sequence::at(uint64_t idx, const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) const {
+    uint32_t low = (uint32_t)idx, wraps = (uint32_t)(idx >> 32);
+    uint32_t gray = low ^ (low >> 1);
+    std::vector<float> out_vec(dims);
+    for (size_t d = 0; d < dims; ++d) {
+        uint32_t x = shift[d];
+        if (wraps != 0) {
+            // another random digital shift keeps the points just as evenly spread, splitmix64 to get one
+            uint64_t z = ((uint64_t)wraps << 32 | shift[d]) + 0x9E3779B97F4A7C15ull * (d + 1);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            x ^= (uint32_t)(z ^ (z >> 31));
+        }
+        const uint32_t* v = &directions[d * 32];
+        for (uint32_t g = gray, j = 0; g != 0; g >>= 1, ++j) {
+            if (g & 1u) x ^= v[j];
+        }
+        // top 24 bits so that we stay below 1 after conversion
+        float unit = (x >> 8) * (1.f / (1u << 24));
+        out_vec[d] = lower_bounds[d] + unit * (upper_bounds[d] - lower_bounds[d]);
+    }
+    return out_vec;
+}
+
+std::vector<float> sobol_sequence::next(const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) {
+    return at(index++, lower_bounds, upper_bounds);
+}
+
+std::vector<std::vector<float>> latin_hypercube(size_t slice_count, size_t slices, size_t slice_idx, uint64_t seed,
+                                                const std::vector<float>& lower_bounds, const std::vector<float>& upper_bounds) {
+    size_t dims = lower_bounds.size();
+    size_t total = slice_count * slices;
+    std::vector<std::vector<float>> points(slice_count, std::vector<float>(dims));
+    // the stratum permutations are shared between slices, the jitter within strata is not
+    std::mt19937_64 shared_gen(seed);
+    std::vector<size_t> strata(total);
+    for (size_t d = 0; d < dims; ++d) {
+        std::iota(strata.begin(), strata.end(), 0);
+        std::shuffle(strata.begin(), strata.end(), shared_gen);
+        for (size_t i = 0; i < slice_count; ++i) {
+            float unit = (strata[slice_idx * slice_count + i] + frand()) / total;
+            points[i][d] = lower_bounds[d] + unit * (upper_bounds[d] - lower_bounds[d]);
+        }
+    }
+    return points;
+}
+
+float_matrix::float_matrix(const std::vector<std::vector<float>>& rows): cols(rows.empty() ? 0 : rows[0].size()) {
+    data.reserve(rows.size() * cols);
+    for (const std::vector<float>& row : rows) {
+        if (row.size() != cols) throw std::runtime_error("matrix rows have mismatched lengths");
+        data.insert(data.end(), row.begin(), row.end());
+    }
+}
+
+std::vector<std::vector<float>> float_matrix::to_rows() const {
+    std::vector<std::vector<float>> rows;
+    for (size_t i = 0; i < size(); ++i) rows.push_back(row_vec(i));
+    return rows;
+}
+
 void log(std::function<std::string()>&& str, size_t log_level, size_t level, bool endl, bool clear) {
     if (log_level < level) return;
     log_mutex.lock();
@@ -1,4 +1,12 @@
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
 #include <vector>
 
 #include <catch2/catch_test_macros.hpp>
@@ -6,10 +14,19 @@
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <argparse/args.hpp>
 
+#include "atmosim.h"
+#include "batch.hpp"
+#include "checkpoint.hpp"
 #include "constants.hpp"
+#include "coordinator.hpp"
 #include "gas.hpp"
+#include "optimise.hpp"
 #include "tank.hpp"
 #include "optimiser.hpp"
+#include "pareto.hpp"
+#include "server.hpp"
+#include "sweep.hpp"
+#include "sim.hpp"
 #include "utility.hpp"
 
 using Catch::Approx;
@@ -105,6 +122,20 @@ TEST_CASE("Vector math operations") {
         REQUIRE(length(noise) == Approx(1.f).epsilon(0.001f));
         REQUIRE(dot(vec, noise) == Approx(0.0f).margin(0.001f));
     }
+
+    SECTION("Matrix rows") {
+        float_matrix mat({{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}});
+        REQUIRE(mat.size() == 3);
+        REQUIRE(mat[1][1] == 4.f);
+        REQUIRE(mat[2].data() == mat[0].data() + 4);
+
+        mat.set_row(0, std::vector<float>{7.f, 8.f});
+        mat.resize(2);
+        REQUIRE(mat.to_rows() == std::vector<std::vector<float>>{{7.f, 8.f}, {3.f, 4.f}});
+        REQUIRE(mat.row_vec(1) == std::vector<float>{3.f, 4.f});
+
+        REQUIRE_THROWS(float_matrix({{1.f}, {2.f, 3.f}}));
+    }
 }
 
 TEST_CASE("Gas system performance benchmarks") {
@@ -325,6 +356,542 @@ TEST_CASE("Tank simulation validation") {
     }
 }
 
+TEST_CASE("Recipe serialisation") {
+    const std::string recipe = "ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]";
+    bomb_data data = bomb_data::deserialize(recipe);
+
+    SECTION("Text round trip") {
+        REQUIRE(data.fuel_temp == 383.13f);
+        REQUIRE(data.fuel_pressure == 662.5f);
+        REQUIRE(data.to_pressure == 1013.25f);
+        REQUIRE(data.thir_temp == 293.15f);
+        REQUIRE(data.mix_gases == std::vector<gas_ref>{plasma, tritium});
+        REQUIRE(data.primer_gases == std::vector<gas_ref>{oxygen});
+        REQUIRE(data.mix_ratios == std::vector<float>{0.537775f, 0.462225f});
+        REQUIRE(data.serialize() == recipe);
+        REQUIRE(data.mix_to_temp == data.tank.mix.temperature);
+
+        // very simple output has extra keys, which get ignored
+        data.optstat = 12.f;
+        bomb_data reread = bomb_data::deserialize(data.print_very_simple());
+        REQUIRE(reread.serialize() == recipe);
+
+        // odd fractions survive exactly
+        bomb_data odd = data;
+        odd.mix_ratios = {1.f, 3.f};
+        bomb_data odd_reread = bomb_data::deserialize(odd.serialize());
+        REQUIRE(odd_reread.serialize() == odd.serialize());
+        REQUIRE(odd_reread.mix_ratios[0] == get_fractions(odd.mix_ratios)[0]);
+    }
+
+    SECTION("Binary round trip") {
+        recipe_record rec = data.to_record();
+        REQUIRE(rec.mix_count == 2);
+        REQUIRE(rec.primer_count == 1);
+        bomb_data from_rec = bomb_data::from_record(rec);
+        REQUIRE(from_rec.serialize() == recipe);
+        REQUIRE(from_rec.tank.mix.pressure() == data.tank.mix.pressure());
+
+        rec.gases[0] = 0xfe;
+        REQUIRE_THROWS(bomb_data::from_record(rec));
+    }
+
+    SECTION("Bad input") {
+        REQUIRE_THROWS(bomb_data::deserialize(""));
+        REQUIRE_THROWS(bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.5]]"));
+        REQUIRE_THROWS(bomb_data::deserialize("ft=38x fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,1]] pm=[[oxygen,1]]"));
+        REQUIRE_THROWS(bomb_data::deserialize("ft=383 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasmb,1]] pm=[[oxygen,1]]"));
+        REQUIRE_THROWS(bomb_data::deserialize("ft=383 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,1],] pm=[[oxygen,1]]"));
+        REQUIRE_THROWS(bomb_data::deserialize("ft=383 fp=662.5 tp=1013.25 tt=293.15 mi=[] pm=[[oxygen,1]]"));
+    }
+
+    SECTION("Serialisation speed") {
+        BENCHMARK("Deserialise") {
+            return bomb_data::deserialize(recipe);
+        };
+        BENCHMARK("Serialise") {
+            return data.serialize();
+        };
+    }
+}
+
+TEST_CASE("Tolerance measurement") {
+    bomb_data data = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]");
+    data.ticks = data.tank.tick_n(1000);
+    data.fin_radius = data.tank.calc_radius();
+    const float tol = 0.95f;
+    const float target_radius = data.fin_radius * tol, target_ticks = data.ticks * tol;
+    const size_t tick_limit = data.ticks / tol;
+
+    thread_pool pool(4);
+    std::vector<param_tolerance> tols = data.tolerances(tol, pool);
+    REQUIRE(tols.size() == 6);
+
+    // bounds should be valid, and one rounding step further should not be
+    for (const param_tolerance& t : tols) {
+        if (t.param.type == recipe_param::mix_ratio_p) continue;
+        float start = t.param.of(data);
+        float step = t.param.round_step(data);
+        REQUIRE(t.min_v <= start);
+        REQUIRE(t.max_v >= start);
+        REQUIRE(data.test_variation(t.param, t.min_v, target_radius, target_ticks, tick_limit));
+        REQUIRE(data.test_variation(t.param, t.max_v, target_radius, target_ticks, tick_limit));
+        REQUIRE(!data.test_variation(t.param, t.min_v - step, target_radius, target_ticks, tick_limit));
+        REQUIRE(!data.test_variation(t.param, t.max_v + step, target_radius, target_ticks, tick_limit));
+    }
+
+    // same result no matter the threading
+    thread_pool single(1);
+    std::vector<param_tolerance> tols_single = data.tolerances(tol, single);
+    for (size_t i = 0; i < tols.size(); ++i) {
+        REQUIRE(tols[i].min_v == tols_single[i].min_v);
+        REQUIRE(tols[i].max_v == tols_single[i].max_v);
+    }
+}
+
+TEST_CASE("Robustness estimate") {
+    bomb_data data = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]");
+    data.ticks = data.tank.tick_n(1000);
+    data.fin_radius = data.tank.calc_radius();
+
+    // no perturbation, always works
+    thread_pool pool(4);
+    robustness_report exact = data.robustness(100, {0.f, 0.f, 0.f}, 0.95f, pool);
+    REQUIRE(exact.successes == 100);
+    REQUIRE(exact.sensitivity.empty());
+
+    mismix_dist dist;
+    robustness_report report = data.robustness(5000, dist, 0.95f, pool, 42);
+    REQUIRE(report.samples == 5000);
+    REQUIRE(report.successes > 0);
+    REQUIRE(report.successes < 5000);
+    REQUIRE(report.ci_low <= report.success_rate());
+    REQUIRE(report.ci_high >= report.success_rate());
+    REQUIRE(report.sensitivity.size() == data.params().size());
+
+    // same result no matter the threading
+    thread_pool single(1);
+    REQUIRE(data.robustness(5000, dist, 0.95f, single, 42).successes == report.successes);
+}
+
+TEST_CASE("Validity map") {
+    bomb_data data = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]");
+    data.ticks = data.tank.tick_n(1000);
+    data.fin_radius = data.tank.calc_radius();
+
+    recipe_param ft = recipe_param::from_key("ft"), mi1 = recipe_param::from_key("mi1");
+    REQUIRE(ft.type == recipe_param::fuel_temp_p);
+    REQUIRE(mi1.type == recipe_param::mix_ratio_p);
+    REQUIRE(mi1.index == 1);
+    REQUIRE_THROWS(recipe_param::from_key("mi"));
+    REQUIRE_THROWS(recipe_param::from_key("xx"));
+
+    // centered on the recipe, which is valid
+    thread_pool pool(4);
+    validity_map map = data.map_validity(ft, 382.13f, 384.13f, 21, mi1, 0.412225f, 0.512225f, 11, 0.95f, pool);
+    REQUIRE(map.radius.size() == 21 * 11);
+    REQUIRE(map.valid[5 * 21 + 10]);
+    REQUIRE(std::count(map.valid.begin(), map.valid.end(), (char)true) < 21 * 11);
+
+    // same as checking one at a time
+    std::pair<recipe_param, float> changes[2] = {{ft, map.x_at(3)}, {mi1, map.y_at(7)}};
+    gas_tank tank = data.build_tank(changes);
+    REQUIRE(tank.tick_n(data.ticks / 0.95f) == (size_t)map.ticks[7 * 21 + 3]);
+
+    std::stringstream csv;
+    map.write_csv(csv);
+    validity_map read = validity_map::read_csv(csv);
+    REQUIRE(read.width == 21);
+    REQUIRE(read.height == 11);
+    REQUIRE(read.x_param.type == recipe_param::fuel_temp_p);
+    REQUIRE(read.y_param.index == 1);
+    REQUIRE(read.valid == map.valid);
+    REQUIRE(read.ticks == map.ticks);
+
+    // ratio axes are fractions of the mix, however the recipe writes its ratios
+    bomb_data scaled = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,1.07555],[tritium,0.92445]] pm=[[oxygen,1]]");
+    scaled.ticks = scaled.tank.tick_n(1000);
+    scaled.fin_radius = scaled.tank.calc_radius();
+    auto [mi_min, mi_max] = scaled.map_range(mi1, 0.95f, pool);
+    REQUIRE(mi_min < 0.462225f);
+    REQUIRE(mi_max > 0.462225f);
+    REQUIRE(mi_max <= 1.f);
+    validity_map centred = scaled.map_validity(ft, 383.13f, 383.13f, 1, mi1, 0.462225f - 0.05f, 0.462225f + 0.05f, 11, 0.95f, pool);
+    REQUIRE(centred.valid[5]);
+    REQUIRE(centred.ticks[5] == (int)scaled.ticks);
+    REQUIRE(centred.radius[5] == Approx(scaled.fin_radius));
+}
+
+TEST_CASE("Batch simulation") {
+    REQUIRE(json_string("a\"b\\c\n") == "\"a\\\"b\\\\c\\n\"");
+    REQUIRE(json_number(NAN) == "null");
+    REQUIRE(json_number(-INFINITY) == "null");
+
+    std::string recipe = "ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]";
+    std::string input;
+    for (size_t i = 0; i < 50; ++i) {
+        input += (i == 20 ? std::string("nonsense") : recipe) + "\n";
+        if (i == 10) input += "\n";
+    }
+    std::stringstream in(input), out;
+    batch_options opts;
+    opts.tick_cap = 1000;
+    opts.chunk_size = 7;
+    thread_pool pool(4);
+    REQUIRE(run_batch(in, out, opts, pool) == 50);
+
+    // output in input order, blank lines skipped but counted
+    std::string line;
+    size_t n = 0, errors = 0;
+    while (std::getline(out, line)) {
+        ++n;
+        size_t line_n = n <= 11 ? n : n + 1;
+        REQUIRE(line.starts_with(std::format("{{\"line\":{},", line_n)));
+        if (line.find("\"error\"") != std::string::npos) {
+            ++errors;
+            REQUIRE(line_n == 22);
+        } else {
+            REQUIRE(line.find("\"state\":\"exploded\"") != std::string::npos);
+        }
+    }
+    REQUIRE(n == 50);
+    REQUIRE(errors == 1);
+}
+
+TEST_CASE("Server") {
+    json_object obj = json_object::parse(R"({"id": 7, "op": "simulate", "tol": 0.9, "flag": true, "gases": ["plasma", "oxygen"], "range": [1, 2.5]})");
+    REQUIRE(obj.get_string("op") == "simulate");
+    REQUIRE(obj.get_float("tol", 0.f) == 0.9f);
+    REQUIRE(obj.get_bool("flag", false));
+    REQUIRE(obj.get_size("missing", 3) == 3);
+    REQUIRE(obj.get_strings("gases") == std::vector<std::string>{"plasma", "oxygen"});
+    REQUIRE(obj.get_floats("range") == std::vector<float>{1.f, 2.5f});
+    REQUIRE(obj.values.at("id").json() == "7");
+    REQUIRE_THROWS(json_object::parse("{\"a\": 1"));
+    REQUIRE_THROWS(obj.get_float("op", 0.f));
+
+    std::string recipe = "ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]";
+    std::stringstream in, out;
+    in << std::format(R"({{"id":1,"op":"simulate","recipe":"{}"}})", recipe) << "\n";
+    in << "garbage\n";
+    in << std::format(R"({{"id":"b","op":"simulate","recipe":"{}"}})", recipe) << "\n";
+    in << R"({"id":2,"op":"optimise","mix":["plasma","tritium"],"primer":["oxygen"],"mixt":[375,595],"thirt":[293.15,293.15],"runtime":0.2,"rounds":1,"ticks":1000})" << "\n";
+    in << R"({"id":"end","op":"shutdown"})" << "\n";
+    in << R"({"id":3,"op":"stats"})" << "\n";
+    {
+        server srv(2, out);
+        srv.serve(in);
+    }
+
+    // replies can come out of order, but every request before shutdown gets one
+    std::map<std::string, std::string> replies;
+    std::string line;
+    while (std::getline(out, line)) {
+        json_object reply = json_object::parse(line);
+        replies[reply.values.at("id").json()] = line;
+    }
+    REQUIRE(replies.size() == 5);
+    REQUIRE(replies["1"].find("\"state\":\"exploded\"") != std::string::npos);
+    REQUIRE(replies["\"b\""].substr(replies["\"b\""].find(',')) == replies["1"].substr(replies["1"].find(',')));
+    REQUIRE(replies["null"].find("\"error\"") != std::string::npos);
+    REQUIRE(json_object::parse(replies["2"]).get_float("radius", 0.f) > 10.f);
+    REQUIRE(!replies.contains("3"));
+}
+
+TEST_CASE("C interface") {
+    REQUIRE(atmosim_gas_count() == gas_count);
+    REQUIRE(atmosim_gas_index("plasma") == (int)plasma.idx);
+    REQUIRE(atmosim_gas_index("nonsense") == -1);
+    REQUIRE(std::string(atmosim_gas_name(oxygen.idx)) == "oxygen");
+
+    std::string recipe = "ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]";
+    bomb_data data = bomb_data::deserialize(recipe);
+    recipe_record rec = data.to_record();
+    std::vector<atmosim_recipe> recipes(3);
+    std::memcpy(&recipes[0], &rec, sizeof(rec));
+    recipes[2] = recipes[0];
+    // recipes[1] is left empty, so invalid
+    std::vector<atmosim_result> results(3);
+
+    atmosim_context* ctx = atmosim_create(2);
+    REQUIRE(ctx != nullptr);
+    REQUIRE(atmosim_simulate(ctx, recipes.data(), results.data(), results.size(), 0) == 1);
+    data.tank.tick_n(std::numeric_limits<size_t>::max());
+    REQUIRE(results[0].error == 0);
+    REQUIRE(results[0].radius == data.tank.calc_radius());
+    REQUIRE(results[0].state == ATMOSIM_EXPLODED);
+    REQUIRE(results[1].error != 0);
+    REQUIRE(results[2].radius == results[0].radius);
+    // reported on our thread, though the recipes were simulated on the context's
+    REQUIRE(std::string(atmosim_last_error()).starts_with("recipe 1: "));
+
+    // an empty config leaves the defaults in place
+    REQUIRE(atmosim_load_config("", 0) == 0);
+    REQUIRE(atmosim_simulate(ctx, recipes.data(), results.data(), 1, 0) == 0);
+    REQUIRE(results[0].radius == results[2].radius);
+
+    atmosim_optimise_params params;
+    atmosim_optimise_defaults(&params);
+    params.mix_gases[0] = plasma.idx;
+    params.mix_gases[1] = tritium.idx;
+    params.mix_count = 2;
+    params.primer_gases[0] = oxygen.idx;
+    params.primer_count = 1;
+    params.mix_temp_min = 375.f;
+    params.mix_temp_max = 595.f;
+    params.thir_temp_min = params.thir_temp_max = 293.15f;
+    params.runtime_seconds = 10.f;
+    params.rounds = 2;
+    params.tick_cap = 1000;
+
+    // stop as soon as we get called
+    size_t calls = 0;
+    atmosim_recipe best;
+    atmosim_result best_result;
+    auto stop = [](float, uint64_t, float, void* user) { ++*(size_t*)user; return 1; };
+    REQUIRE(atmosim_optimise(ctx, &params, stop, &calls, &best, &best_result) == 0);
+    REQUIRE(calls == 1);
+    REQUIRE(best_result.error == 0);
+    REQUIRE(best.mix_count == 2);
+
+    params.mix_count = 0;
+    REQUIRE(atmosim_optimise(ctx, &params, nullptr, nullptr, &best, &best_result) < 0);
+    REQUIRE(std::string(atmosim_last_error()).size() > 0);
+    atmosim_destroy(ctx);
+}
+
+TEST_CASE("Optimise options") {
+    optimise_options opts;
+    opts.mix_gases = {plasma, tritium};
+    opts.primer_gases = {oxygen, nitrogen};
+    opts.mixt1 = 375.15f;
+    opts.mixt2 = 595.15f;
+    opts.thirt1 = opts.thirt2 = 293.15f;
+    opts.mix_to_solve = true;
+    opts.ratio_lower = {-1.f, -2.f};
+    opts.ratio_upper = {1.f, 0.5f};
+    opts.tick_cap = 1200;
+    opts.round_ratio_to = 0.1f;
+    opts.opt_param = bomb_data::ticks_field;
+    opts.maximise = false;
+    opts.post_restrictions = argp::parse_value<std::vector<field_restriction<bomb_data>>>("[[radius,20],[ticks,-,300.5]]");
+    opts.robust_ratio = 0.5f;
+    opts.screen_horizons = {100, 400};
+    opts.init_mode = "lhs";
+    opts.max_evals = 5000;
+    opts.surrogate_size = 64;
+
+    // everything the flags can set makes it to workers and back
+    optimise_options read = optimise_options::from_json(json_object::parse("{" + opts.to_json_fields() + "}"));
+    REQUIRE(read.to_json_fields() == opts.to_json_fields());
+    REQUIRE(read.mix_gases.size() == 2);
+    REQUIRE(read.primer_gases[1].idx == nitrogen.idx);
+    REQUIRE(read.ratio_upper == opts.ratio_upper);
+    REQUIRE(read.tick_cap == 1200);
+    REQUIRE(field_name(read.opt_param) == field_name(bomb_data::ticks_field));
+    REQUIRE(read.post_restrictions.size() == 2);
+    REQUIRE(read.post_restrictions[0].max_v == std::numeric_limits<float>::max());
+    REQUIRE(read.post_restrictions[1].min_v == -std::numeric_limits<float>::max());
+    REQUIRE(read.post_restrictions[1].max_v == 300.5f);
+    REQUIRE(read.screen_horizons == opts.screen_horizons);
+    REQUIRE(read.init_mode == "lhs");
+    // no tick cap is left out, and missing fields read back as defaults
+    REQUIRE(optimise_options::from_json(json_object::parse(R"({"mix":["plasma"],"primer":["oxygen"],"mixt":[375,595],"thirt":[293.15,293.15]})")).tick_cap
+            == std::numeric_limits<size_t>::max());
+
+    auto [lower, upper] = read.bounds();
+    REQUIRE(lower == std::vector<float>{plasma_fire_temp + 0.1f, 375.15f, 293.15f, pressure_cap, -1.f, -2.f});
+    // solving the mix-to temperature searches it on its own
+    REQUIRE(upper[0] == lower[0]);
+    optimise_run run(read);
+    REQUIRE(run.solve_target.enabled());
+    REQUIRE(run.solve_target.upper == 595.15f);
+    REQUIRE(run.optim.args.round_ratio_to == Catch::Approx(0.001f));
+    REQUIRE(run.robust.ratio_delta == Catch::Approx(0.005f));
+    REQUIRE(run.optim.init_mode == optimise_run::optimiser_t::init_lhs);
+
+    read.ratio_lower.pop_back();
+    REQUIRE_THROWS(read.validate());
+    read.ratio_lower.clear();
+    read.ratio_upper.clear();
+    read.init_mode = "random";
+    REQUIRE_THROWS(optimise_run(read));
+    REQUIRE_THROWS(optimise_options::from_json(json_object::parse(R"({"mix":["plasma"],"primer":["oxygen"],"mixt":[375],"thirt":[293.15,293.15]})")));
+}
+
+TEST_CASE("Worker processes") {
+    coordinator_options opts;
+    opts.request.mix_gases = {plasma, tritium};
+    opts.request.primer_gases = {oxygen};
+    opts.request.mixt1 = 375.15f;
+    opts.request.mixt2 = 595.15f;
+    opts.request.thirt1 = opts.request.thirt2 = 293.15f;
+    opts.request.runtime = 1.f;
+    opts.epochs = 2;
+
+    SECTION("Forked workers") {
+        coordinator_result res = run_coordinator(opts);
+        REQUIRE(res.worker_deaths == 0);
+        REQUIRE(res.evals > 0);
+        REQUIRE(res.best_arg.size() == 5);
+        REQUIRE(res.best_optstat > 10.f);
+        REQUIRE(json_object::parse(res.best_json).get_float("radius", 0.f) == res.best_optstat);
+        // a reply from every worker in every epoch
+        REQUIRE(res.result_args.size() == 4);
+        REQUIRE(std::find(res.result_args.begin(), res.result_args.end(), res.best_arg) != res.result_args.end());
+    }
+
+    SECTION("Silenced output") {
+        // like --silent, which workers forked from us mustn't inherit
+        std::cout.setstate(std::ios::failbit);
+        coordinator_result res = run_coordinator(opts);
+        std::cout.clear();
+        REQUIRE(res.worker_deaths == 0);
+        REQUIRE(res.best_optstat > 10.f);
+    }
+
+    SECTION("Search options") {
+        opts.request.init_mode = "sobol";
+        opts.request.robust_temp = 0.1f;
+        opts.request.robust_pressure = 0.5f;
+        opts.request.robust_ratio = 0.1f;
+        opts.request.stall_gens = 20;
+        opts.request.restarts = true;
+        opts.request.ratio_lower = {-1.f};
+        opts.request.ratio_upper = {1.f};
+        coordinator_result res = run_coordinator(opts);
+        REQUIRE(res.worker_deaths == 0);
+        REQUIRE(res.best_arg.size() == 5);
+        REQUIRE(std::abs(res.best_arg[4]) <= 1.f);
+        REQUIRE(res.best_optstat > 10.f);
+        // rated by its worst mismix
+        REQUIRE(res.best_optstat <= json_object::parse(res.best_json).get_float("radius", 0.f));
+    }
+
+    SECTION("Dead workers") {
+        // reads its request and exits without replying
+        opts.worker_command = {"sh", "-c", "read line"};
+        opts.max_restarts = 1;
+        // dies in the first epoch, again after the restart in the second, with no restarts left for the third
+        opts.epochs = 3;
+        REQUIRE_THROWS(run_coordinator(opts));
+    }
+
+    SECTION("Hung workers") {
+        opts.worker_command = {"sleep", "30"};
+        opts.request.runtime = 0.1f;
+        opts.epochs = 1;
+        opts.timeout_grace = 0.1f;
+        coordinator_result res = run_coordinator(opts);
+        REQUIRE(res.worker_deaths == 2);
+        REQUIRE(res.best_json.empty());
+    }
+}
+
+TEST_CASE("Robust objective") {
+    std::vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen};
+    std::vector<field_restriction<bomb_data>> no_restrictions;
+    std::vector<float> in_args = {375.15f, 383.15f, 293.15f, 1013.25f, std::log(0.46f / 0.54f)};
+    bomb_args args{mix_gases, primer_gases, false, 0.1f, 0.01f, 0.00001f, 1000, bomb_data::radius_field, no_restrictions, no_restrictions};
+
+    opt_val_wrap nominal = do_sim(in_args, args);
+    REQUIRE(nominal.valid());
+
+    robust_args robust;
+    robust.temp_delta = 2.f;
+    robust.pressure_delta = 10.f;
+    robust.ratio_delta = 0.02f;
+    args.robust = &robust;
+
+    // worst case can't be better than nominal, best case can't be worse
+    opt_val_wrap worst = do_sim(in_args, args);
+    REQUIRE(worst.valid());
+    REQUIRE(worst.rating() <= nominal.rating());
+    REQUIRE(robust.best_rating.load() == worst.rating());
+
+    robust.quantile = 1.f;
+    opt_val_wrap best = do_sim(in_args, args);
+    REQUIRE(best.valid());
+    REQUIRE(best.rating() >= nominal.rating());
+
+    // nominally worse than what we've already found: pruned, but still valid
+    robust.best_rating = nominal.rating() + 1.f;
+    opt_val_wrap pruned = do_sim(in_args, args);
+    REQUIRE(pruned.valid());
+    REQUIRE(pruned.pruned());
+    // ranks below anything fully rated, but never as a best or top result
+    using optimiser_t = optimiser<bomb_args, opt_val_wrap>;
+    REQUIRE(optimiser_t::better_than(nominal, pruned, true));
+    REQUIRE(optimiser_t::better_than(nominal, pruned, false));
+    REQUIRE(!optimiser_t::better_than(pruned, opt_val_wrap(), true));
+    REQUIRE(optimiser_t::better_eq_than(pruned, opt_val_wrap(), true));
+
+    // each search starts from nothing
+    optimiser_t optim(do_sim, {375.15f, 383.15f, 293.15f, 1013.25f, -1.f}, {375.15f, 383.15f, 293.15f, 1013.25f, 1.f},
+                      true, args, as_seconds(10.f), 1, 0.5f);
+    optim.on_start = [&robust] { robust.reset(); };
+    optim.max_evals = 100;
+    optim.top_count = 10;
+    robust.best_rating = std::numeric_limits<float>::max();
+    optim.find_best();
+    REQUIRE(optim.best_result.valid());
+    REQUIRE(!optim.best_result.pruned());
+    REQUIRE(robust.best_rating.load() == optim.best_result.rating());
+    for (const auto& [at, res] : optim.top_results) REQUIRE(!res.pruned());
+}
+
+TEST_CASE("Screened simulation") {
+    std::vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen, nitrogen};
+    std::vector<field_restriction<bomb_data>> no_restrictions;
+    bomb_args args{mix_gases, primer_gases, false, 0.1f, 0.01f, 0.00001f, 3000, bomb_data::ticks_field, no_restrictions, no_restrictions};
+    std::vector<float> lower = {300.f, 300.f, 100.f, 1013.25f, -3.f, -3.f}, upper = {1200.f, 1200.f, 600.f, 1013.25f, 3.f, 3.f};
+
+    // seeded, so it's the same points every run
+    std::mt19937 rng(1234);
+    std::vector<std::vector<float>> points(400, std::vector<float>(lower.size()));
+    for (std::vector<float>& at : points) {
+        for (size_t d = 0; d < at.size(); ++d) at[d] = std::uniform_real_distribution<float>(lower[d], upper[d])(rng);
+    }
+
+    // whatever gets through screening is simulated exactly as without it
+    auto check = [&](float keep_fraction) {
+        screen_args screen({50, 200, 1000}, keep_fraction);
+        screen.warmup = 4;
+        size_t kept = 0;
+        for (const std::vector<float>& at : points) {
+            args.screen = nullptr;
+            opt_val_wrap exact = do_sim(at, args);
+            args.screen = &screen;
+            opt_val_wrap screened = do_sim(at, args);
+            if (screened.pruned()) {
+                REQUIRE(screened.valid());
+            } else {
+                REQUIRE(screened.valid() == exact.valid());
+            }
+            if (exact.valid() && !screened.pruned()) {
+                ++kept;
+                REQUIRE(screened.data->ticks == exact.data->ticks);
+                REQUIRE(screened.data->fin_pressure == exact.data->fin_pressure);
+                REQUIRE(screened.data->tank.state == exact.data->tank.state);
+            }
+        }
+        return std::pair{kept, screen.discarded()};
+    };
+
+    // discards from right after warmup
+    screen_args direct({50}, 0.5f);
+    direct.warmup = 4;
+    for (float score : {1.f, 2.f, 3.f, 4.f}) REQUIRE(direct.promote(0, score));
+    REQUIRE(!direct.promote(0, 0.5f));
+    REQUIRE(direct.promote(0, 5.f));
+
+    auto [kept_all, discarded_none] = check(1.f);
+    REQUIRE(discarded_none == 0);
+    auto [kept_some, discarded_some] = check(0.f);
+    REQUIRE(discarded_some > 0);
+    REQUIRE(kept_some < kept_all);
+}
+
 // wrapper for bomb_data for use by the optimiser
 struct float_wrap {
     float data = 0.f;
@@ -440,3 +1007,496 @@ TEST_CASE("Optimiser validation") {
         }
     }
 }
+
+TEST_CASE("Optimiser termination") {
+    optimiser<std::tuple<>, float_wrap>
+    optim(opt_fun,
+        {0.f, -0.5f},
+        {1.f, 1.5f},
+        true,
+        std::make_tuple(),
+        as_seconds(60.f),
+        5,
+        0.5f);
+    optim.poll_spacing = as_seconds(0.01f);
+
+    SECTION("Evaluation budget") {
+        optim.max_evals = 500;
+        time_point_t start = main_clock.now();
+        optim.find_best();
+
+        REQUIRE(optim.eval_count == 500);
+        REQUIRE(to_seconds(main_clock.now() - start) < 10.f);
+        REQUIRE(optim.best_result.valid());
+    }
+
+    SECTION("Stagnation") {
+        optim.stall_generations = 20;
+        optim.stall_epsilon = 1e-4f;
+        time_point_t start = main_clock.now();
+        optim.find_best();
+
+        REQUIRE(to_seconds(main_clock.now() - start) < 10.f);
+        REQUIRE(optim.best_result.data == Approx(1.092f).epsilon(0.01f));
+    }
+
+    SECTION("Restarts") {
+        optim.max_evals = 500;
+        optim.find_best();
+        float global_best = optim.best_result.data;
+        optim.max_evals = 0;
+        optim.stall_generations = 5;
+        optim.restart_on_stall = true;
+
+        optimiser<std::tuple<>, float_wrap>::sampler samp(optim, 0, false);
+        samp.reset();
+        // far from the best and too narrow to improve in, so it stalls
+        samp.start_round({0.1f, 0.1f}, {0.1001f, 0.1001f});
+        samp.until = main_clock.now() + as_seconds(10.f);
+        samp.do_sampling();
+        REQUIRE(samp.restarts == 1);
+        REQUIRE(samp.pop_size == 2 * optim.pop_size);
+        REQUIRE(samp.cur_lower_bounds == optim.lower_bounds);
+        REQUIRE(samp.cur_upper_bounds == optim.upper_bounds);
+        REQUIRE(samp.best_result.data == global_best);
+        REQUIRE(samp.best_arg == optim.best_arg);
+
+        samp.until = main_clock.now();
+        samp.do_sampling();
+        REQUIRE(samp.population.size() == samp.pop_size);
+        REQUIRE(samp.best_result.data >= global_best);
+
+        // populations too small to evolve would never stall again
+        optim.restart_pop_growth = 0.1f;
+        for (int i = 0; i < 3; ++i) samp.restart();
+        REQUIRE(samp.pop_size == 4);
+    }
+}
+
+TEST_CASE("Checkpoint and resume") {
+    std::string path = (std::filesystem::temp_directory_path() / "atmosim_test_checkpoint.txt").string();
+    using optimiser_t = optimiser<std::tuple<>, float_wrap>;
+    auto setup = [&](optimiser_t& optim) {
+        optim.n_threads = 2;
+        optim.poll_spacing = as_seconds(0.01f);
+        optim.checkpoint_path = path;
+        optim.checkpoint_spacing = as_seconds(0.05f);
+        optim.checkpoint_key = "test";
+    };
+
+    // stop partway through the second round
+    optimiser_t first(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(1.f), 4, 0.5f);
+    setup(first);
+    std::atomic<bool> cancel = false;
+    first.cancel_flag = &cancel;
+    first.on_poll = [&](float fraction) { if (fraction > 0.3f) cancel = true; };
+    first.find_best();
+    REQUIRE(first.best_result.valid());
+
+    optimiser_checkpoint ck = optimiser_checkpoint::load(path);
+    REQUIRE(ck.round == 1);
+    REQUIRE(ck.in_round);
+    REQUIRE(ck.eval_count == first.eval_count);
+    REQUIRE(ck.best_arg == first.best_arg);
+    REQUIRE(ck.samplers.size() == 2);
+    REQUIRE(!ck.samplers[0].population.empty());
+
+    optimiser_t second(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(1.f), 4, 0.5f);
+    setup(second);
+    second.resume(path);
+    second.find_best();
+    REQUIRE(second.eval_count > first.eval_count);
+    REQUIRE(second.best_result.data >= first.best_result.data);
+    REQUIRE(second.best_result.data == Approx(1.092f).epsilon(0.01f));
+    ck = optimiser_checkpoint::load(path);
+    REQUIRE(ck.round == 4);
+    REQUIRE(!ck.in_round);
+
+    optimiser_t other(opt_fun, {0.f, -0.5f}, {2.f, 1.5f}, true, std::make_tuple(), as_seconds(1.f), 4, 0.5f);
+    setup(other);
+    REQUIRE_THROWS(other.resume(path));
+    other.checkpoint_key = "other";
+    other.lower_bounds = second.lower_bounds;
+    other.upper_bounds = second.upper_bounds;
+    REQUIRE_THROWS(other.resume(path));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Seeded start") {
+    SECTION("Recipe to optimiser args") {
+        std::vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen};
+        std::vector<field_restriction<bomb_data>> no_restrictions;
+        bomb_args args{mix_gases, primer_gases, false, 0.1f, 0.01f, 0.00001f, 1000, bomb_data::radius_field, no_restrictions, no_restrictions};
+        bomb_data recipe = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]");
+        recipe.sim_ticks(1000, bomb_data::radius_field, false);
+
+        std::vector<float> in_args = recipe_args(recipe, mix_gases, primer_gases);
+        REQUIRE(in_args.size() == 5);
+        opt_val_wrap res = do_sim(in_args, args);
+        REQUIRE(res.valid());
+        REQUIRE(res.data->fin_radius == Approx(recipe.fin_radius).epsilon(0.01f));
+
+        // gases the recipe lacks get next to nothing
+        std::vector<gas_ref> more_primer = {oxygen, nitrogen};
+        std::vector<float> more_args = recipe_args(recipe, mix_gases, more_primer);
+        REQUIRE(more_args.size() == 6);
+        REQUIRE(more_args[5] < -10.f);
+
+        // which the optimiser raises to the smallest share its bounds allow
+        std::vector<float> lower_bounds = in_args, upper_bounds = in_args;
+        lower_bounds.push_back(-3.f);
+        upper_bounds.push_back(3.f);
+        bomb_args more_bomb_args{mix_gases, more_primer, false, 0.1f, 0.01f, 0.00001f, 1000, bomb_data::radius_field, no_restrictions, no_restrictions};
+        optimiser<bomb_args, opt_val_wrap> optim(do_sim, lower_bounds, upper_bounds, true, more_bomb_args, as_seconds(10.f), 1, 0.5f);
+        optim.seeds = {more_args};
+        optim.max_evals = 1;
+        optim.find_best();
+        REQUIRE(optim.seeds[0][5] == -3.f);
+        REQUIRE(optim.best_arg == optim.seeds[0]);
+        REQUIRE(optim.best_result.valid());
+        REQUIRE(optim.best_result.data->primer_ratios[1] == Approx(1.f / (1.f + std::exp(3.f))).epsilon(0.01f));
+    }
+
+    SECTION("Optimiser seeds") {
+        optimiser<std::tuple<>, float_wrap>
+        search(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(0.5f), 3, 0.5f);
+        search.find_best();
+
+        optimiser<std::tuple<>, float_wrap>
+        seeded(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(10.f), 3, 0.5f);
+        seeded.seeds = {{0.5f, 0.5f}, search.best_arg};
+        seeded.max_evals = 50;
+        seeded.find_best();
+        REQUIRE(seeded.eval_count == 50);
+        REQUIRE(seeded.best_result.data >= search.best_result.data);
+    }
+
+    SECTION("Seeds in the first population") {
+        using optimiser_t = optimiser<std::tuple<>, float_wrap>;
+        optimiser_t optim(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(10.f), 3, 0.5f);
+        optim.n_threads = 1;
+        std::vector<float> best_seed = {0.2f, 0.f}, other_seed = {0.6f, 0.f};
+        REQUIRE(opt_fun(best_seed, {}).data > opt_fun(other_seed, {}).data);
+        optim.seeds = {best_seed, other_seed};
+        // only rates the seeds
+        optim.max_evals = 2;
+        optim.find_best();
+        REQUIRE(optim.eval_count == 2);
+
+        optimiser_t::sampler samp(optim, 0, false);
+        samp.reset();
+        samp.start_round(optim.lower_bounds, optim.upper_bounds);
+        // just the initial population, whose two seeds were already rated
+        optim.max_evals = samp.pop_size;
+        samp.until = main_clock.now();
+        samp.do_sampling();
+        REQUIRE(optim.eval_count == optim.max_evals);
+        REQUIRE(std::ranges::equal(samp.population[1], other_seed));
+        REQUIRE(samp.fitness[1].valid());
+        float other_rating = samp.fitness[1].data;
+        REQUIRE(other_rating == opt_fun(other_seed, {}).data);
+
+        // a generation only replaces it with something at least as good
+        optim.max_evals += samp.pop_size;
+        samp.until = main_clock.now() + as_seconds(10.f);
+        samp.do_sampling();
+        REQUIRE(samp.fitness[1].data >= other_rating);
+    }
+}
+
+TEST_CASE("Solved mix-to temperature") {
+    std::vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen};
+    std::vector<field_restriction<bomb_data>> no_restrictions;
+    bomb_args args{mix_gases, primer_gases, false, 0.1f, 0.5f, 0.00001f, 1000, bomb_data::radius_field, no_restrictions, no_restrictions};
+    bomb_data recipe = bomb_data::deserialize("ft=383.13 fp=662.5 tp=1013.25 tt=293.15 mi=[[plasma,0.537775],[tritium,0.462225]] pm=[[oxygen,1]]");
+    std::vector<float> in_args = recipe_args(recipe, mix_gases, primer_gases);
+
+    in_args[0] = plasma_fire_temp + 0.1f;
+    opt_val_wrap fixed = do_sim(in_args, args);
+
+    target_solve_args solve{plasma_fire_temp + 0.1f, 1000.f, true};
+    args.solve_target = &solve;
+    in_args[0] = 0.f;
+    opt_val_wrap solved = do_sim(in_args, args);
+    REQUIRE(solved.valid());
+    REQUIRE(solved.data->fin_radius >= fixed.data->fin_radius);
+    REQUIRE(solved.data->mix_to_temp > plasma_fire_temp);
+
+    // a peak on the rounding grid
+    args.solve_target = nullptr;
+    for (float target : {solved.data->mix_to_temp - 0.5f, solved.data->mix_to_temp + 0.5f}) {
+        in_args[0] = target;
+        opt_val_wrap res = do_sim(in_args, args);
+        if (res.valid()) REQUIRE(res.data->fin_radius <= solved.data->fin_radius);
+    }
+}
+
+// opt_fun with a third dimension that barely matters
+float_wrap opt_fun_flat(const std::vector<float>& in_args, const std::tuple<>& args) {
+    return {opt_fun(in_args, args).data + 0.0001f * in_args[2]};
+}
+
+TEST_CASE("Sensitivity pass") {
+    optimiser<std::tuple<>, float_wrap>
+    optim(opt_fun_flat, {0.f, -0.5f, 0.f}, {1.f, 1.5f, 1.f}, true, std::make_tuple(), as_seconds(0.5f), 3, 0.5f);
+    optim.sensitivity_trajectories = 20;
+    optim.find_best();
+    REQUIRE(optim.sensitivity.size() == 3);
+    REQUIRE(optim.sensitivity[0].effects == 20);
+    REQUIRE(!optim.sensitivity[0].frozen);
+    REQUIRE(!optim.sensitivity[1].frozen);
+    REQUIRE(optim.sensitivity[2].frozen);
+    REQUIRE(optim.sensitivity[2].mu_star < optim.sensitivity[0].mu_star);
+    REQUIRE(optim.best_arg[2] == optim.fixed_at[2]);
+    REQUIRE(optim.best_result.data == Approx(1.092f).epsilon(0.01f));
+
+    // frozen dimensions are free again on the next run
+    optim.sensitivity_trajectories = 0;
+    optim.find_best();
+    REQUIRE(optim.sensitivity.empty());
+    REQUIRE(!optim.fixed_dims[2]);
+}
+
+TEST_CASE("Sensitivity with screening") {
+    std::vector<gas_ref> mix_gases = {plasma, tritium}, primer_gases = {oxygen, nitrogen};
+    std::vector<field_restriction<bomb_data>> no_restrictions;
+    bomb_args args{mix_gases, primer_gases, false, 0.1f, 0.01f, 0.00001f, 3000, bomb_data::ticks_field, no_restrictions, no_restrictions};
+    // the target temperature is always between the fuel and primer ones, so every point is valid
+    std::vector<float> lower = {300.f, 500.f, 100.f, 1013.25f, -3.f, -3.f}, upper = {400.f, 600.f, 200.f, 1013.25f, 3.f, 3.f};
+    auto run = [&](const screen_args* screen) {
+        args.screen = screen;
+        optimiser<bomb_args, opt_val_wrap> optim(do_sim, lower, upper, true, args, as_seconds(10.f), 1, 0.5f, LOG_NONE);
+        optim.init_seed = 1234;
+        optim.sensitivity_trajectories = 100;
+        // just the sensitivity pass, 5 active dimensions
+        optim.max_evals = 100 * 6;
+        optim.find_best();
+        return optim.sensitivity;
+    };
+    auto exact = run(nullptr);
+    screen_args screen({50, 200, 1000}, 0.3f);
+    screen.warmup = 4;
+    auto screened = run(&screen);
+    REQUIRE(screen.discarded() > 0);
+
+    // discarded candidates aren't invalid, so they don't make a dimension look like it matters for validity
+    size_t exact_effects = 0, screened_effects = 0;
+    for (size_t d = 0; d < lower.size(); ++d) {
+        REQUIRE(exact[d].validity_flips == 0);
+        REQUIRE(screened[d].validity_flips == 0);
+        exact_effects += exact[d].effects;
+        screened_effects += screened[d].effects;
+    }
+    REQUIRE(screened_effects < exact_effects);
+}
+
+TEST_CASE("Surrogate screening") {
+    optimiser<std::tuple<>, float_wrap>
+    optim(opt_fun, {0.f, -0.5f}, {1.f, 1.5f}, true, std::make_tuple(), as_seconds(10.f), 3, 0.5f);
+    optim.surrogate_size = 200;
+    optim.max_evals = 3000;
+    optim.find_best();
+    REQUIRE(optim.surrogate_skipped > 0);
+    // skipped trials would mostly have lost
+    REQUIRE(optim.surrogate_checked[0] > 0);
+    REQUIRE(optim.surrogate_correct[0] * 3 > optim.surrogate_checked[0] * 2);
+    REQUIRE(optim.best_result.data == Approx(1.092f).epsilon(0.01f));
+}
+
+TEST_CASE("Diverse top results") {
+    // three equally high peaks, 0.31 of the bounds apart
+    optimiser<std::tuple<>, float_wrap>
+    optim(opt_sine,
+        {0.f},
+        {20.f},
+        true,
+        std::make_tuple(),
+        as_seconds(0.2f),
+        1);
+    // DE converges on one peak, so the others rely on the initial population covering the bounds evenly
+    optim.init_mode = optim.init_sobol;
+    optim.top_count = 3;
+    optim.top_distance = 0.1f;
+    size_t reported = 0;
+    optim.on_top_result = [&](const std::vector<float>&, const float_wrap&, size_t idx) {
+        REQUIRE(idx < 3);
+        ++reported;
+    };
+    optim.find_best();
+
+    REQUIRE(optim.top_results.size() == 3);
+    REQUIRE(reported >= 3);
+    for (size_t i = 0; i < 3; ++i) {
+        REQUIRE(optim.top_results[i].second.data > 0.8f);
+        for (size_t j = 0; j < i; ++j) {
+            REQUIRE(optim.top_results[j].second.data >= optim.top_results[i].second.data);
+            REQUIRE(optim.arg_distance(optim.top_results[i].first, optim.top_results[j].first) > 0.1f);
+        }
+    }
+    REQUIRE(optim.top_results[0].second.data == optim.best_result.data);
+}
+
+TEST_CASE("Pareto front") {
+    // minimise x^2 and (x - 2)^2, so every x in [0, 2] is on the front
+    pareto_optimiser<std::tuple<>, float_wrap>
+    pareto([](const std::vector<float>& in_args, const std::tuple<>&) { return float_wrap(in_args[0]); },
+           [](const float_wrap& res) { return std::vector<float>{-res.data * res.data, -(res.data - 2.f) * (res.data - 2.f)}; },
+           {-5.f},
+           {5.f},
+           std::make_tuple(),
+           as_seconds(10.f));
+    pareto.max_evals = 5000;
+    pareto.n_threads = 2;
+    pareto.find_front();
+
+    REQUIRE(pareto.eval_count == 5000);
+    REQUIRE(pareto.front.size() == pareto.max_front);
+    bool sorted = true, any_dominated = false;
+    for (size_t i = 0; i < pareto.front.size(); ++i) {
+        float x = pareto.front[i].result.data;
+        REQUIRE(x >= -0.01f);
+        REQUIRE(x <= 2.01f);
+        if (i > 0) sorted &= pareto.front[i - 1].obj[0] > pareto.front[i].obj[0];
+        for (size_t j = 0; j < pareto.front.size(); ++j) {
+            any_dominated |= decltype(pareto)::dominates(pareto.front[i], pareto.front[j]);
+        }
+    }
+    REQUIRE(sorted);
+    REQUIRE(!any_dominated);
+    // crowding spreads the front out over the whole range
+    REQUIRE(pareto.front.front().result.data < 0.1f);
+    REQUIRE(pareto.front.back().result.data > 1.9f);
+}
+
+TEST_CASE("Gas combination sweep") {
+    sweep_options opts;
+    opts.gases = {plasma, tritium, oxygen};
+    opts.max_mix_gases = 2;
+    opts.max_primer_gases = 1;
+    opts.lower_bounds = {375.15f, 375.15f, 293.15f, pressure_cap};
+    opts.upper_bounds = {375.15f, 595.15f, 293.15f, pressure_cap};
+    opts.total_seconds = 2.f;
+    thread_pool pool(2);
+    std::vector<sweep_result> results = sweep_gases(opts, pool);
+
+    // 3 single gas fuels with 2 primers each, 3 pairs with the one gas left
+    REQUIRE(results.size() == 9);
+    // 9 -> 5 -> 3 -> 2 -> 1
+    REQUIRE(results[0].rungs == 5);
+    REQUIRE(results[1].rungs == 4);
+    bool ordered = true, disjoint = true;
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) ordered &= results[i - 1].rungs >= results[i].rungs;
+        for (gas_ref gas : results[i].primer_gases) {
+            disjoint &= std::find(results[i].mix_gases.begin(), results[i].mix_gases.end(), gas) == results[i].mix_gases.end();
+        }
+    }
+    REQUIRE(ordered);
+    REQUIRE(disjoint);
+    REQUIRE(results[0].best.valid());
+    REQUIRE(results[0].best.data->fin_radius > 10.f);
+}
+
+TEST_CASE("Low-discrepancy sampling") {
+    const size_t dims = 6, count = 64;
+    std::vector<float> lower(dims, 0.f), upper(dims, 1.f);
+
+    // every 1D projection of a power of two block should hit every stratum exactly once
+    auto check_strata = [&](const std::vector<std::vector<float>>& points) {
+        for (size_t d = 0; d < dims; ++d) {
+            std::vector<int> hits(points.size(), 0);
+            for (const auto& p : points) {
+                REQUIRE(p[d] >= 0.f);
+                REQUIRE(p[d] < 1.f);
+                ++hits[(size_t)(p[d] * points.size())];
+            }
+            REQUIRE(std::all_of(hits.begin(), hits.end(), [](int h){ return h == 1; }));
+        }
+    };
+
+    SECTION("Sobol") {
+        sobol_sequence seq(dims, 1234);
+        for (size_t block = 0; block < 3; ++block) {
+            std::vector<std::vector<float>> points;
+            for (size_t i = 0; i < count; ++i) points.push_back(seq.next(lower, upper));
+            check_strata(points);
+        }
+
+        // past 2^32 points it doesn't start over, but is still evenly spread
+        const uint64_t wrap = 1ull << 32;
+        std::vector<std::vector<float>> points;
+        for (size_t i = 0; i < count; ++i) points.push_back(seq.at(wrap + i, lower, upper));
+        check_strata(points);
+        REQUIRE(points[0] != seq.at(0, lower, upper));
+        REQUIRE(seq.at(2 * wrap, lower, upper) != points[0]);
+    }
+
+    SECTION("Latin hypercube slices") {
+        std::vector<std::vector<float>> points;
+        for (size_t slice = 0; slice < 4; ++slice) {
+            std::vector<std::vector<float>> part = latin_hypercube(count / 4, 4, slice, 1234, lower, upper);
+            points.insert(points.end(), part.begin(), part.end());
+        }
+        check_strata(points);
+    }
+}
+
+TEST_CASE("Grid search") {
+    optimiser<std::tuple<>, float_wrap>
+    optim(opt_fun,
+        {0.f, -0.5f},
+        {1.f, 1.5f},
+        true,
+        std::make_tuple(),
+        as_seconds(0.f),
+        1);
+    std::vector<float> steps = {0.01f, 0.01f};
+
+    REQUIRE(optim.grid_size(steps) == 101 * 201);
+
+    SECTION("Single thread") {
+        REQUIRE(optim.grid_search(steps, 3));
+    }
+    SECTION("Multiple threads") {
+        optim.n_threads = 4;
+        REQUIRE(optim.grid_search(steps, 3));
+    }
+
+    REQUIRE(optim.eval_count == 101 * 201);
+    REQUIRE(optim.top_results.size() == 3);
+    REQUIRE(optim.top_results[0].second.data >= optim.top_results[1].second.data);
+    REQUIRE(optim.top_results[1].second.data >= optim.top_results[2].second.data);
+    REQUIRE(optim.best_arg[0] == Approx(0.29f).margin(0.005f));
+    REQUIRE(optim.best_arg[1] == Approx(0.f).margin(0.005f));
+    REQUIRE(optim.best_result.data == Approx(1.092f).epsilon(0.01f));
+}
+
+TEST_CASE("Ratio lattice") {
+    // every point is a different recipe once do_sim rounds it
+    auto rounded_fractions = [](const std::vector<float>& log_ratios, float round_ratio_to) {
+        std::vector<float> ratios = {1.f};
+        for (float r : log_ratios) ratios.push_back(std::exp(r));
+        std::vector<float> fractions = get_fractions(ratios);
+        for (float& f : fractions) f = round_to(f, round_ratio_to);
+        return fractions;
+    };
+    for (auto [lower, upper, round_ratio_to] : {std::tuple{std::vector<float>{-3.f}, std::vector<float>{3.f}, 0.005f},
+                                                std::tuple{std::vector<float>{-1.f, -2.f}, std::vector<float>{1.f, 0.5f}, 0.02f}}) {
+        std::vector<std::vector<float>> points = ratio_lattice(lower, upper, round_ratio_to, 100000);
+        REQUIRE(!points.empty());
+        std::set<std::vector<float>> recipes;
+        for (const std::vector<float>& point : points) {
+            for (size_t i = 0; i < point.size(); ++i) {
+                REQUIRE(point[i] >= lower[i]);
+                REQUIRE(point[i] <= upper[i]);
+            }
+            std::vector<float> fractions = rounded_fractions(point, round_ratio_to);
+            REQUIRE(std::accumulate(fractions.begin(), fractions.end(), 0.f) == Approx(1.f));
+            recipes.insert(fractions);
+        }
+        REQUIRE(recipes.size() == points.size());
+    }
+    // 5% to 95% in steps of 0.5%
+    REQUIRE(ratio_lattice({-3.f}, {3.f}, 0.005f, 100000).size() == 181);
+    REQUIRE(ratio_lattice({-3.f}, {3.f}, 0.005f, 10).size() == 11);
+}